@@ -6,17 +6,30 @@
 #include <optional>
 
 #include "web_socket_server.hpp"
+#include "tile_worker.hpp"
 
-template<RenderableObject... ObjectTypes>
+template<typename Shaders, RenderableObject... ObjectTypes>
 class Application {
 public:
-	std::jthread launch_web(std::uint16_t port, const Renderer<ObjectTypes...>::Info& renderer_info) {
-		this->web_socket_server.emplace(port, renderer_info);
+	/// @param thread_count Threads serving the sessions.
+	/// @param render_job_limits Workers and queue length for single-frame HTTP requests.
+	std::jthread launch_web(
+		std::uint16_t port, const Renderer<Shaders, ObjectTypes...>::Info& renderer_info,
+		const FramePacing& pacing = {}, std::size_t thread_count = std::thread::hardware_concurrency(),
+		const RenderJobs<Shaders, ObjectTypes...>::Limits& render_job_limits = {}
+	) {
+		this->web_socket_server.emplace(port, renderer_info, pacing, thread_count, render_job_limits);
 		return std::jthread{ [this]() { this->web_socket_server->run(); } };
 	}
 
+	/// @brief Draws tiles for renderers whose Info::distribution lists this process, until it ends.
+	/// @param renderer_info Builds the same scene as the coordinator's.
+	void run_tile_worker(std::uint16_t port, const Renderer<Shaders, ObjectTypes...>::Info& renderer_info) {
+		TileWorker<Shaders, ObjectTypes...>{ port, renderer_info }.run();
+	}
+
 private:
-	std::optional<WebSocketServer<ObjectTypes...>> web_socket_server;
+	std::optional<WebSocketServer<Shaders, ObjectTypes...>> web_socket_server;
 };
 
 #endif
\ No newline at end of file
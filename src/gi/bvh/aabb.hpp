@@ -0,0 +1,66 @@
+#ifndef GI_BAH8454_AABB
+#define GI_BAH8454_AABB
+
+#include <limits>
+
+#include "../util.hpp"
+#include "../ray.hpp"
+
+/// @brief Axis-aligned bounding box.  A default constructed box is empty (minimum > maximum) so it can be grown.
+class AABB {
+public:
+	AABB() {}
+	AABB(const Vector3& minimum, const Vector3& maximum) : minimum{ minimum }, maximum{ maximum } {}
+
+	void grow(const Vector3& point) {
+		this->minimum = this->minimum.cwiseMin(point);
+		this->maximum = this->maximum.cwiseMax(point);
+	}
+
+	void grow(const AABB& other) {
+		this->minimum = this->minimum.cwiseMin(other.minimum);
+		this->maximum = this->maximum.cwiseMax(other.maximum);
+	}
+
+	AABB intersection(const AABB& other) const {
+		return { this->minimum.cwiseMax(other.minimum), this->maximum.cwiseMin(other.maximum) };
+	}
+
+	bool is_empty() const {
+		return this->minimum.x() > this->maximum.x() || this->minimum.y() > this->maximum.y() || this->minimum.z() > this->maximum.z();
+	}
+
+	Vector3 centroid() const {
+		return (this->minimum + this->maximum) / 2;
+	}
+
+	Vector3 extent() const {
+		return this->maximum - this->minimum;
+	}
+
+	Real surface_area() const {
+		if (this->is_empty()) { return 0; }
+		Vector3 e = this->extent();
+		return 2 * (e.x() * e.y() + e.y() * e.z() + e.z() * e.x());
+	}
+
+	/// @brief Slab test.
+	/// @param inverse_direction Component-wise reciprocal of the ray direction (precomputed once per ray).
+	/// @return The distance to the entry point, or infinity if the box is missed or further than maximum_distance.
+	Real intersects(const Ray& ray, const Vector3& inverse_direction, Real maximum_distance) const {
+		Real t_near = 0;
+		Real t_far = maximum_distance;
+		for (int axis = 0; axis < 3; ++axis) {
+			Real t0 = (this->minimum[axis] - ray.origin[axis]) * inverse_direction[axis];
+			Real t1 = (this->maximum[axis] - ray.origin[axis]) * inverse_direction[axis];
+			t_near = std::max(t_near, std::min(t0, t1));
+			t_far = std::min(t_far, std::max(t0, t1));
+		}
+		return t_near <= t_far ? t_near : std::numeric_limits<Real>::infinity();
+	}
+
+	Vector3 minimum{ std::numeric_limits<Real>::infinity(), std::numeric_limits<Real>::infinity(), std::numeric_limits<Real>::infinity() };
+	Vector3 maximum{ -std::numeric_limits<Real>::infinity(), -std::numeric_limits<Real>::infinity(), -std::numeric_limits<Real>::infinity() };
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,158 @@
+#ifndef GI_BAH8454_BVH
+#define GI_BAH8454_BVH
+
+#include <chrono>
+#include <cstdint>
+
+#include <sycl/sycl.hpp>
+
+#include "../util.hpp"
+#include "aabb.hpp"
+#include "bvh_node.hpp"
+#include "sah_builder.hpp"
+#include "lbvh_builder.hpp"
+#include "sbvh_builder.hpp"
+#include "wide_bvh.hpp"
+#include "compressed_bvh.hpp"
+
+/// @brief Bounding volume hierarchy over the renderer's objects, stored in shared memory so kernels can traverse it.
+class BVH {
+public:
+	enum class Builder { sah, sbvh, lbvh };
+
+	class Info {
+	public:
+		Builder builder = Builder::lbvh;
+		MortonPrecision morton_precision = MortonPrecision::bits_30;
+		// Only used by the SAH and SBVH builders, the LBVH always emits single primitive leaves.
+		std::size_t maximum_leaf_size = 4;
+		// Extra primitive references the SBVH builder may create by spatial splits, as a fraction of the primitive count.
+		Real duplication_budget = 0.3;
+		// Children per node: 2, or 4/8 to collapse the binary hierarchy into wide nodes traversed with vector instructions (best on CPU devices).
+		std::size_t width = 2;
+		// Quantize the child bounds of wide nodes to 8 bits.  Requires width 4 or 8; maximum_leaf_size is capped at 255.
+		bool compressed = false;
+	};
+
+	BVH(sycl::queue& q, const Info& info) :
+		q{ q },
+		info{ info },
+		nodes{ SharedAllocator<BVHNode>{ q } },
+		nodes4{ SharedAllocator<WideBVHNode<4>>{ q } },
+		nodes8{ SharedAllocator<WideBVHNode<8>>{ q } },
+		compressed_nodes4{ SharedAllocator<CompressedWideBVHNode<4>>{ q } },
+		compressed_nodes8{ SharedAllocator<CompressedWideBVHNode<8>>{ q } },
+		indices{ SharedAllocator<std::uint32_t>{ q } },
+		primitive_bounds{ SharedAllocator<AABB>{ q } },
+		lbvh_builder{ q }
+	{}
+
+	BVH(const BVH&) = delete;
+
+	/// @brief Rebuilds the hierarchy over objects (which must already be in camera coordinates).
+	template <typename Object>
+	void build(const Object* objects, std::size_t count) {
+		this->build(objects, count, this->info);
+	}
+
+	template <typename Object>
+	void build(const Object* objects, std::size_t count, const Info& info) {
+		// Compressed nodes count a leaf's primitives in 8 bits.
+		std::size_t maximum_leaf_size = info.compressed && info.width != 2 ? std::min(info.maximum_leaf_size, CompressedWideBVHNode<4>::maximum_leaf_size) : info.maximum_leaf_size;
+		auto start = std::chrono::high_resolution_clock::now();
+		// Obtain the bounds of every object.
+		this->primitive_bounds.resize(count);
+		this->q.parallel_for(
+			{ count },
+			[objects, primitive_bounds = this->primitive_bounds.data()](std::size_t i) {
+				primitive_bounds[i] = visit([](const auto& object) { return object.get_bounds(); }, objects[i]);
+			}
+		).wait();
+		if (info.builder == Builder::sah) {
+			this->sah_builder.build(this->primitive_bounds.data(), count, maximum_leaf_size, this->nodes, this->indices);
+		} else if (info.builder == Builder::sbvh) {
+			auto clip = [objects](std::uint32_t i, int axis, Real minimum, Real maximum) {
+				return visit([&](const auto& object) { return object.get_clipped_bounds(axis, minimum, maximum); }, objects[i]);
+			};
+			this->sbvh_builder.build(this->primitive_bounds.data(), count, maximum_leaf_size, info.duplication_budget, clip, this->nodes, this->indices);
+		} else {
+			this->lbvh_builder.build(this->primitive_bounds.data(), count, info.morton_precision, this->nodes, this->indices);
+		}
+		this->width = info.width;
+		this->compressed = info.compressed && this->width != 2;
+		if (this->width == 4) {
+			collapse_bvh(this->nodes, this->nodes4);
+			if (this->compressed) { compress_bvh(this->nodes4, this->compressed_nodes4); }
+		} else if (this->width == 8) {
+			collapse_bvh(this->nodes, this->nodes8);
+			if (this->compressed) { compress_bvh(this->nodes8, this->compressed_nodes8); }
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		this->build_time = std::chrono::duration<Real>{ end - start }.count();
+	}
+
+	/// @brief Traverses whichever hierarchy the device data points to.  See traverse_bvh for the meaning of the parameters.
+	template <typename Object, typename Intersector>
+	static bool traverse(const DeviceData<Object>& data, const Ray& ray, Real& maximum_distance, Intersector&& intersect, bool any_hit = false) {
+		if (data.bvh_width == 8 && data.bvh_compressed) {
+			return traverse_wide_bvh(data.compressed_bvh8_nodes, data.bvh8_node_count, data.bvh_indices, ray, maximum_distance, intersect, any_hit);
+		}
+		if (data.bvh_width == 4 && data.bvh_compressed) {
+			return traverse_wide_bvh(data.compressed_bvh4_nodes, data.bvh4_node_count, data.bvh_indices, ray, maximum_distance, intersect, any_hit);
+		}
+		if (data.bvh_width == 8) {
+			return traverse_wide_bvh(data.bvh8_nodes, data.bvh8_node_count, data.bvh_indices, ray, maximum_distance, intersect, any_hit);
+		}
+		if (data.bvh_width == 4) {
+			return traverse_wide_bvh(data.bvh4_nodes, data.bvh4_node_count, data.bvh_indices, ray, maximum_distance, intersect, any_hit);
+		}
+		return traverse_bvh(data.bvh_nodes, data.bvh_node_count, data.bvh_indices, ray, maximum_distance, intersect, any_hit);
+	}
+
+	/// @brief Size in bytes of the nodes traversal reads plus the primitive index list.
+	std::size_t get_memory_footprint() const {
+		std::size_t node_bytes = this->nodes.size() * sizeof(BVHNode);
+		if (this->width == 4) {
+			node_bytes = this->nodes4.size() * (this->compressed ? sizeof(CompressedWideBVHNode<4>) : sizeof(WideBVHNode<4>));
+		} else if (this->width == 8) {
+			node_bytes = this->nodes8.size() * (this->compressed ? sizeof(CompressedWideBVHNode<8>) : sizeof(WideBVHNode<8>));
+		}
+		return node_bytes + this->indices.size() * sizeof(std::uint32_t);
+	}
+
+	/// @brief Expected cost of tracing a random ray under the surface area heuristic, counting one unit per node visited and per primitive tested.
+	Real get_sah_cost() const {
+		if (this->nodes.empty()) { return 0; }
+		Real root_area = this->nodes[0].bounds.surface_area();
+		Real cost = 0;
+		for (const BVHNode& node : this->nodes) {
+			cost += (node.is_leaf() ? node.count : 1) * node.bounds.surface_area() / root_area;
+		}
+		return cost;
+	}
+
+	sycl::queue& q;
+	Info info;
+
+	// Layout of the hierarchy produced by the last build.
+	std::size_t width = 2;
+	bool compressed = false;
+	Shared<BVHNode, SharedAllocator<BVHNode>> nodes;
+	Shared<WideBVHNode<4>, SharedAllocator<WideBVHNode<4>>> nodes4;
+	Shared<WideBVHNode<8>, SharedAllocator<WideBVHNode<8>>> nodes8;
+	Shared<CompressedWideBVHNode<4>, SharedAllocator<CompressedWideBVHNode<4>>> compressed_nodes4;
+	Shared<CompressedWideBVHNode<8>, SharedAllocator<CompressedWideBVHNode<8>>> compressed_nodes8;
+	Shared<std::uint32_t, SharedAllocator<std::uint32_t>> indices;
+
+	// Duration of the last build in seconds.
+	Real build_time = 0;
+
+private:
+	Shared<AABB, SharedAllocator<AABB>> primitive_bounds;
+
+	SAHBuilder sah_builder;
+	SBVHBuilder sbvh_builder;
+	LBVHBuilder lbvh_builder;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,83 @@
+#ifndef GI_BAH8454_BVH_NODE
+#define GI_BAH8454_BVH_NODE
+
+#include <cstdint>
+#include <limits>
+
+#include "../util.hpp"
+#include "../ray.hpp"
+#include "aabb.hpp"
+
+/// @brief A node of a binary bounding volume hierarchy.
+class BVHNode {
+public:
+	static constexpr std::uint32_t no_parent = std::numeric_limits<std::uint32_t>::max();
+
+	bool is_leaf() const {
+		return this->count > 0;
+	}
+
+	AABB bounds;
+	// Interior nodes store the indices of their children.  Leaves store the first entry of their range in the BVH's primitive index list in left.
+	std::uint32_t left = 0;
+	std::uint32_t right = 0;
+	// Number of primitives referenced by a leaf (0 for interior nodes).
+	std::uint32_t count = 0;
+	std::uint32_t parent = BVHNode::no_parent;
+};
+
+// Maximum depth of a hierarchy that traversal supports.  The LBVH builder produces at most 63 + 32 levels and the SAH builder far fewer.
+constexpr std::size_t bvh_stack_size = 128;
+
+/// @brief Traverses a binary BVH front to back, calling intersect for every primitive in every leaf the ray reaches.
+/// @param intersect Callable taking a primitive index and returning the hit distance if it is closer than maximum_distance (or an empty Optional).
+/// @param maximum_distance Updated with the distance of the closest hit so far; nodes further away are culled.
+/// @param any_hit Stop at the first hit (shadow rays).
+/// @return Whether anything was hit.
+template <typename Intersector>
+inline bool traverse_bvh(
+	const BVHNode* nodes,
+	std::size_t node_count,
+	const std::uint32_t* indices,
+	const Ray& ray,
+	Real& maximum_distance,
+	Intersector&& intersect,
+	bool any_hit = false
+) {
+	if (node_count == 0) { return false; }
+	Vector3 inverse_direction = ray.direction.cwiseInverse();
+	bool hit = false;
+	Array<std::uint32_t, bvh_stack_size> stack;
+	std::size_t stack_size = 0;
+	if (nodes[0].bounds.intersects(ray, inverse_direction, maximum_distance) == std::numeric_limits<Real>::infinity()) {
+		return false;
+	}
+	stack[stack_size++] = 0;
+	while (stack_size > 0) {
+		const BVHNode& node = nodes[stack[--stack_size]];
+		if (node.is_leaf()) {
+			for (std::uint32_t i = node.left; i < node.left + node.count; ++i) {
+				if (auto distance = intersect(indices[i])) {
+					maximum_distance = *distance;
+					hit = true;
+					if (any_hit) { return true; }
+				}
+			}
+			continue;
+		}
+		// Visit the nearer child first so the far child is more likely to be culled by a hit.
+		Real left_distance = nodes[node.left].bounds.intersects(ray, inverse_direction, maximum_distance);
+		Real right_distance = nodes[node.right].bounds.intersects(ray, inverse_direction, maximum_distance);
+		std::uint32_t near_child = node.left;
+		std::uint32_t far_child = node.right;
+		if (right_distance < left_distance) {
+			std::swap(near_child, far_child);
+			std::swap(left_distance, right_distance);
+		}
+		if (right_distance != std::numeric_limits<Real>::infinity()) { stack[stack_size++] = far_child; }
+		if (left_distance != std::numeric_limits<Real>::infinity()) { stack[stack_size++] = near_child; }
+	}
+	return hit;
+}
+
+#endif
\ No newline at end of file
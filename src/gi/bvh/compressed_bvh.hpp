@@ -0,0 +1,132 @@
+#ifndef GI_BAH8454_COMPRESSED_BVH
+#define GI_BAH8454_COMPRESSED_BVH
+
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+#include "../util.hpp"
+#include "../ray.hpp"
+#include "bvh_node.hpp"
+#include "wide_bvh.hpp"
+
+template <std::size_t width>
+class QuantizedVectorType {
+public:
+	typedef std::uint8_t type __attribute__((vector_size(width)));
+};
+
+template <std::size_t width>
+using QuantizedVector = typename QuantizedVectorType<width>::type;
+
+/// @brief A wide node whose child boxes are stored as 8-bit offsets on a power of two grid spanning the node's own box.
+/// Boxes are rounded outwards when quantized, so a child box never shrinks.  BVH4 nodes take one cache line and BVH8 nodes two.
+template <std::size_t width>
+class alignas(64) CompressedWideBVHNode {
+public:
+	static constexpr std::size_t lane_count = width;
+	static constexpr std::uint32_t no_child = WideBVHNode<width>::no_child;
+	static constexpr int grid_size = 255;
+
+	/// @brief Decodes the child boxes and slab tests the ray against them.
+	/// @return Per-lane entry distances; lanes that miss (or are further than maximum_distance) hold infinity.
+	RealVector<width> intersects(const Ray& ray, const Vector3& inverse_direction, Real maximum_distance) const {
+		RealVector<width> t_near = RealVector<width>{};
+		RealVector<width> t_far = RealVector<width>{} + maximum_distance;
+		for (int axis = 0; axis < 3; ++axis) {
+			// Decode the box edges relative to the ray origin before scaling by the inverse direction.
+			// Folding the inverse direction into the spacing would produce infinity - infinity for axis-parallel rays.
+			Real spacing = CompressedWideBVHNode::get_spacing(this->exponents[axis]);
+			Real offset = this->origin[axis] - ray.origin[axis];
+			RealVector<width> t0 = (__builtin_convertvector(this->minimum[axis], RealVector<width>) * spacing + offset) * inverse_direction[axis];
+			RealVector<width> t1 = (__builtin_convertvector(this->maximum[axis], RealVector<width>) * spacing + offset) * inverse_direction[axis];
+			t_near = vector_max(t_near, vector_min(t0, t1));
+			t_far = vector_min(t_far, vector_max(t0, t1));
+		}
+		return t_near <= t_far ? t_near : RealVector<width>{} + std::numeric_limits<Real>::infinity();
+	}
+
+	bool is_empty(std::size_t lane) const {
+		return this->children[lane] == CompressedWideBVHNode::no_child;
+	}
+
+	/// @brief 2^exponent, assembled directly from its bits instead of calling ldexp inside the traversal loop.
+	static Real get_spacing(int exponent) {
+		static_assert(sizeof(Real) == sizeof(std::uint32_t), "Grid spacing is assembled as a single precision float.");
+		return std::bit_cast<Real>(static_cast<std::uint32_t>(exponent + 127) << 23);
+	}
+
+	// Minimum corner of the quantization grid and the power of two grid spacing per axis.
+	Real origin[3];
+	std::int8_t exponents[3];
+	// Quantized child bounds, indexed by axis then lane.
+	QuantizedVector<width> minimum[3];
+	QuantizedVector<width> maximum[3];
+	// Number of primitives in a leaf child (0 for interior and empty children).
+	Array<std::uint8_t, width> counts;
+	static constexpr std::size_t maximum_leaf_size = std::numeric_limits<std::uint8_t>::max();
+	// Interior children store the index of their node, leaves store the first entry of their range in the primitive index list.
+	Array<std::uint32_t, width> children;
+};
+
+/// @brief Quantizes every node of a wide BVH.  Node indices are preserved so child links carry over unchanged.
+template <std::size_t width>
+void compress_bvh(
+	const Shared<WideBVHNode<width>, SharedAllocator<WideBVHNode<width>>>& wide_nodes,
+	Shared<CompressedWideBVHNode<width>, SharedAllocator<CompressedWideBVHNode<width>>>& compressed_nodes
+) {
+	compressed_nodes.resize(wide_nodes.size());
+	for (std::size_t i = 0; i < wide_nodes.size(); ++i) {
+		const WideBVHNode<width>& node = wide_nodes[i];
+		CompressedWideBVHNode<width> compressed{};
+		for (int axis = 0; axis < 3; ++axis) {
+			// The grid spans the union of the children.
+			Real minimum = std::numeric_limits<Real>::infinity();
+			Real maximum = -std::numeric_limits<Real>::infinity();
+			for (std::size_t lane = 0; lane < width; ++lane) {
+				if (node.is_empty(lane)) { continue; }
+				minimum = std::min(minimum, node.minimum[axis][lane]);
+				maximum = std::max(maximum, node.maximum[axis][lane]);
+			}
+			if (minimum > maximum) { minimum = maximum = 0; }
+			// Smallest power of two spacing whose grid covers the extent (exact to multiply, so decoding only rounds once).
+			int exponent = -100;
+			if (maximum > minimum) {
+				std::frexp((maximum - minimum) / CompressedWideBVHNode<width>::grid_size, &exponent);
+				exponent = std::max(exponent, -100);
+			}
+			Real spacing = CompressedWideBVHNode<width>::get_spacing(exponent);
+			compressed.origin[axis] = minimum;
+			compressed.exponents[axis] = static_cast<std::int8_t>(exponent);
+			for (std::size_t lane = 0; lane < width; ++lane) {
+				if (node.is_empty(lane)) {
+					// Traversal skips empty lanes by their child index.
+					compressed.minimum[axis][lane] = 0;
+					compressed.maximum[axis][lane] = 0;
+					continue;
+				}
+				// Round outwards, then nudge until the decoded box (computed as the kernel does) contains the child.
+				int low = std::clamp(static_cast<int>(std::floor((node.minimum[axis][lane] - minimum) / spacing)), 0, CompressedWideBVHNode<width>::grid_size);
+				int high = std::clamp(static_cast<int>(std::ceil((node.maximum[axis][lane] - minimum) / spacing)), 0, CompressedWideBVHNode<width>::grid_size);
+				while (low > 0 && minimum + low * spacing > node.minimum[axis][lane]) { --low; }
+				while (high < CompressedWideBVHNode<width>::grid_size && minimum + high * spacing < node.maximum[axis][lane]) { ++high; }
+				compressed.minimum[axis][lane] = static_cast<std::uint8_t>(low);
+				compressed.maximum[axis][lane] = static_cast<std::uint8_t>(high);
+			}
+		}
+		for (std::size_t lane = 0; lane < width; ++lane) {
+			// A truncated count would turn the leaf into an interior node.
+			if (node.counts[lane] > CompressedWideBVHNode<width>::maximum_leaf_size) {
+				throw std::runtime_error{ "Compressed BVH nodes hold leaves of at most 255 primitives." };
+			}
+			compressed.children[lane] = node.children[lane];
+			compressed.counts[lane] = static_cast<std::uint8_t>(node.counts[lane]);
+		}
+		compressed_nodes[i] = compressed;
+	}
+}
+
+#endif
\ No newline at end of file
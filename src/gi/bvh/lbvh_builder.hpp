@@ -0,0 +1,232 @@
+#ifndef GI_BAH8454_LBVH_BUILDER
+#define GI_BAH8454_LBVH_BUILDER
+
+#include <bit>
+#include <cstdint>
+
+#include <sycl/sycl.hpp>
+
+#include "../util.hpp"
+#include "aabb.hpp"
+#include "bvh_node.hpp"
+#include "radix_sort.hpp"
+
+enum class MortonPrecision { bits_30, bits_63 };
+
+namespace morton {
+
+/// @brief Inserts two zero bits after each of the lower 10 bits of v.
+inline std::uint32_t expand_bits(std::uint32_t v) {
+	v &= 0x000003ff;
+	v = (v | (v << 16)) & 0x030000ff;
+	v = (v | (v << 8)) & 0x0300f00f;
+	v = (v | (v << 4)) & 0x030c30c3;
+	v = (v | (v << 2)) & 0x09249249;
+	return v;
+}
+
+/// @brief Inserts two zero bits after each of the lower 21 bits of v.
+inline std::uint64_t expand_bits(std::uint64_t v) {
+	v &= 0x00000000001fffff;
+	v = (v | (v << 32)) & 0x001f00000000ffff;
+	v = (v | (v << 16)) & 0x001f0000ff0000ff;
+	v = (v | (v << 8)) & 0x100f00f00f00f00f;
+	v = (v | (v << 4)) & 0x10c30c30c30c30c3;
+	v = (v | (v << 2)) & 0x1249249249249249;
+	return v;
+}
+
+/// @brief Interleaves the bits of a point inside the unit cube (10 bits per axis for 32-bit codes, 21 bits per axis for 64-bit codes).
+template <typename Code>
+inline Code encode(const Vector3& unit_position) {
+	constexpr Real resolution = static_cast<Real>(Code{ 1 } << (sizeof(Code) == 4 ? 10 : 21));
+	Code x = static_cast<Code>(std::min(std::max(unit_position.x() * resolution, 0_r), resolution - 1));
+	Code y = static_cast<Code>(std::min(std::max(unit_position.y() * resolution, 0_r), resolution - 1));
+	Code z = static_cast<Code>(std::min(std::max(unit_position.z() * resolution, 0_r), resolution - 1));
+	return (morton::expand_bits(x) << 2) | (morton::expand_bits(y) << 1) | morton::expand_bits(z);
+}
+
+};
+
+/// @brief Builds a linear BVH (Karras 2012): primitives are ordered along a Morton curve by their centroids and every interior node is emitted independently.
+/// All stages are kernels on the given queue, so the builder runs on CPU threads or the GPU.
+class LBVHBuilder {
+public:
+	LBVHBuilder(sycl::queue& q) :
+		q{ q },
+		codes_30{ SharedAllocator<std::uint32_t>{ q } },
+		codes_63{ SharedAllocator<std::uint64_t>{ q } },
+		sorter_30{ q },
+		sorter_63{ q },
+		partial_bounds{ SharedAllocator<AABB>{ q } },
+		visit_counts{ SharedAllocator<std::uint32_t>{ q } }
+	{}
+
+	void build(
+		const AABB* bounds,
+		std::size_t count,
+		MortonPrecision precision,
+		Shared<BVHNode, SharedAllocator<BVHNode>>& nodes,
+		Shared<std::uint32_t, SharedAllocator<std::uint32_t>>& indices
+	) {
+		if (precision == MortonPrecision::bits_30) {
+			this->build(bounds, count, this->codes_30, this->sorter_30, nodes, indices);
+		} else {
+			this->build(bounds, count, this->codes_63, this->sorter_63, nodes, indices);
+		}
+	}
+
+private:
+	// Number of primitives reduced serially by each work-item when computing the centroid bounds.
+	static constexpr std::size_t reduction_block_size = 1024;
+
+	template <typename Code>
+	void build(
+		const AABB* bounds,
+		std::size_t count,
+		Shared<Code, SharedAllocator<Code>>& codes,
+		RadixSorter<Code>& sorter,
+		Shared<BVHNode, SharedAllocator<BVHNode>>& nodes,
+		Shared<std::uint32_t, SharedAllocator<std::uint32_t>>& indices
+	) {
+		nodes.resize(count == 0 ? 0 : 2 * count - 1);
+		indices.resize(count);
+		if (count == 0) { return; }
+		codes.resize(count);
+		this->visit_counts.resize(count);
+		// Reduce the centroid bounds: one partial box per block, then a final pass into partial_bounds[0].
+		std::size_t block_count = (count + LBVHBuilder::reduction_block_size - 1) / LBVHBuilder::reduction_block_size;
+		this->partial_bounds.resize(block_count);
+		this->q.parallel_for(
+			{ block_count },
+			[bounds, count, partial_bounds = this->partial_bounds.data()](std::size_t block) {
+				AABB result{};
+				std::size_t end = std::min(count, (block + 1) * LBVHBuilder::reduction_block_size);
+				for (std::size_t i = block * LBVHBuilder::reduction_block_size; i < end; ++i) {
+					result.grow(bounds[i].centroid());
+				}
+				partial_bounds[block] = result;
+			}
+		).wait();
+		this->q.single_task([block_count, partial_bounds = this->partial_bounds.data()]() {
+			for (std::size_t block = 1; block < block_count; ++block) {
+				partial_bounds[0].grow(partial_bounds[block]);
+			}
+		}).wait();
+		// Compute the Morton code of every centroid.
+		this->q.parallel_for(
+			{ count },
+			[bounds, codes = codes.data(), indices = indices.data(), scene_bounds = this->partial_bounds.data()](std::size_t i) {
+				Vector3 extent = scene_bounds->extent();
+				for (int axis = 0; axis < 3; ++axis) {
+					if (extent[axis] <= 0) { extent[axis] = 1; }
+				}
+				codes[i] = morton::encode<Code>((bounds[i].centroid() - scene_bounds->minimum).cwiseQuotient(extent));
+				indices[i] = static_cast<std::uint32_t>(i);
+			}
+		).wait();
+		// Sort the primitives along the curve.
+		sorter.sort(codes.data(), indices.data(), count);
+		// Emit the leaves.  Interior nodes occupy [0, count - 1) and leaves [count - 1, 2 * count - 1).
+		this->q.parallel_for(
+			{ count },
+			[bounds, count, nodes = nodes.data(), indices = indices.data(), visit_counts = this->visit_counts.data()](std::size_t i) {
+				BVHNode leaf{};
+				leaf.bounds = bounds[indices[i]];
+				leaf.left = static_cast<std::uint32_t>(i);
+				leaf.count = 1;
+				nodes[count - 1 + i] = leaf;
+				visit_counts[i] = 0;
+			}
+		).wait();
+		if (count == 1) { return; }
+		// Emit the interior nodes.
+		this->q.parallel_for(
+			{ count - 1 },
+			[count, codes = codes.data(), nodes = nodes.data()](std::size_t index) {
+				auto [left, right] = LBVHBuilder::find_children(codes, static_cast<std::int64_t>(count), static_cast<std::int64_t>(index));
+				nodes[index].left = left;
+				nodes[index].right = right;
+				nodes[index].count = 0;
+				nodes[left].parent = static_cast<std::uint32_t>(index);
+				nodes[right].parent = static_cast<std::uint32_t>(index);
+			}
+		).wait();
+		nodes[0].parent = BVHNode::no_parent;
+		// Propagate the bounds bottom-up.  The second thread to arrive at a node knows both children are done, fits it and continues upwards.
+		this->q.parallel_for(
+			{ count },
+			[count, nodes = nodes.data(), visit_counts = this->visit_counts.data()](std::size_t i) {
+				std::uint32_t index = nodes[count - 1 + i].parent;
+				while (index != BVHNode::no_parent) {
+					sycl::atomic_ref<std::uint32_t, sycl::memory_order::acq_rel, sycl::memory_scope::device, sycl::access::address_space::global_space> visits{ visit_counts[index] };
+					if (visits.fetch_add(1) == 0) { return; }
+					AABB node_bounds = nodes[nodes[index].left].bounds;
+					node_bounds.grow(nodes[nodes[index].right].bounds);
+					nodes[index].bounds = node_bounds;
+					index = nodes[index].parent;
+				}
+			}
+		).wait();
+	}
+
+	/// @brief Length of the common prefix of two sorted codes, with the primitive indices breaking ties between duplicate codes.
+	template <typename Code>
+	static int common_prefix(const Code* codes, std::int64_t count, std::int64_t i, std::int64_t j) {
+		if (j < 0 || j >= count) { return -1; }
+		Code a = codes[i];
+		Code b = codes[j];
+		if (a == b) {
+			return static_cast<int>(sizeof(Code) * 8) + std::countl_zero(static_cast<std::uint32_t>(i ^ j));
+		}
+		return std::countl_zero(static_cast<Code>(a ^ b));
+	}
+
+	/// @brief Determines the range covered by interior node i and where it splits.
+	/// @return The node indices of the left and right children.
+	template <typename Code>
+	static Tuple<std::uint32_t, std::uint32_t> find_children(const Code* codes, std::int64_t count, std::int64_t i) {
+		// Direction of the range.
+		std::int64_t d = LBVHBuilder::common_prefix(codes, count, i, i + 1) - LBVHBuilder::common_prefix(codes, count, i, i - 1) >= 0 ? 1 : -1;
+		// Find an upper bound for the range length, then binary search for the other end.
+		int minimum_prefix = LBVHBuilder::common_prefix(codes, count, i, i - d);
+		std::int64_t maximum_length = 2;
+		while (LBVHBuilder::common_prefix(codes, count, i, i + maximum_length * d) > minimum_prefix) {
+			maximum_length *= 2;
+		}
+		std::int64_t length = 0;
+		for (std::int64_t t = maximum_length / 2; t >= 1; t /= 2) {
+			if (LBVHBuilder::common_prefix(codes, count, i, i + (length + t) * d) > minimum_prefix) {
+				length += t;
+			}
+		}
+		std::int64_t j = i + length * d;
+		// Binary search for the split position.
+		int node_prefix = LBVHBuilder::common_prefix(codes, count, i, j);
+		std::int64_t split_offset = 0;
+		std::int64_t t = length;
+		do {
+			t = (t + 1) / 2;
+			if (LBVHBuilder::common_prefix(codes, count, i, i + (split_offset + t) * d) > node_prefix) {
+				split_offset += t;
+			}
+		} while (t > 1);
+		std::int64_t split = i + split_offset * d + std::min<std::int64_t>(d, 0);
+		// Children that cover a single primitive are leaves.
+		std::int64_t leaf_offset = count - 1;
+		std::int64_t left = std::min(i, j) == split ? leaf_offset + split : split;
+		std::int64_t right = std::max(i, j) == split + 1 ? leaf_offset + split + 1 : split + 1;
+		return { static_cast<std::uint32_t>(left), static_cast<std::uint32_t>(right) };
+	}
+
+	sycl::queue& q;
+
+	Shared<std::uint32_t, SharedAllocator<std::uint32_t>> codes_30;
+	Shared<std::uint64_t, SharedAllocator<std::uint64_t>> codes_63;
+	RadixSorter<std::uint32_t> sorter_30;
+	RadixSorter<std::uint64_t> sorter_63;
+	Shared<AABB, SharedAllocator<AABB>> partial_bounds;
+	Shared<std::uint32_t, SharedAllocator<std::uint32_t>> visit_counts;
+};
+
+#endif
\ No newline at end of file
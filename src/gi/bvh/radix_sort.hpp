@@ -0,0 +1,115 @@
+#ifndef GI_BAH8454_RADIX_SORT
+#define GI_BAH8454_RADIX_SORT
+
+#include <cstdint>
+#include <utility>
+
+#include <sycl/sycl.hpp>
+
+#include "../util.hpp"
+
+/// @brief Stable least-significant-digit radix sort of key/value pairs run on a sycl::queue.
+/// Each pass splits the input into blocks; every work-item histograms and scatters one block, so the sort parallelizes across blocks on both CPU and GPU devices.
+template <typename Key>
+class RadixSorter {
+public:
+	static constexpr std::size_t radix_bits = 8;
+	static constexpr std::size_t radix_size = std::size_t{ 1 } << RadixSorter::radix_bits;
+	static constexpr std::size_t pass_count = (sizeof(Key) * 8) / RadixSorter::radix_bits;
+	// Number of keys handled by a single work-item.
+	static constexpr std::size_t block_size = 2048;
+
+	static_assert(RadixSorter::pass_count % 2 == 0, "An even number of passes leaves the result in the caller's buffers.");
+
+	RadixSorter(sycl::queue& q) :
+		q{ q },
+		key_scratch{ SharedAllocator<Key>{ q } },
+		value_scratch{ SharedAllocator<std::uint32_t>{ q } },
+		histograms{ SharedAllocator<std::uint32_t>{ q } },
+		digit_offsets{ SharedAllocator<std::uint32_t>{ q } }
+	{}
+
+	/// @brief Sorts keys in place, applying the same permutation to values.
+	void sort(Key* keys, std::uint32_t* values, std::size_t count) {
+		if (count <= 1) { return; }
+		std::size_t block_count = (count + RadixSorter::block_size - 1) / RadixSorter::block_size;
+		this->key_scratch.resize(count);
+		this->value_scratch.resize(count);
+		this->histograms.resize(RadixSorter::radix_size * block_count);
+		this->digit_offsets.resize(RadixSorter::radix_size);
+		Key* source_keys = keys;
+		std::uint32_t* source_values = values;
+		Key* destination_keys = this->key_scratch.data();
+		std::uint32_t* destination_values = this->value_scratch.data();
+		for (std::size_t pass = 0; pass < RadixSorter::pass_count; ++pass) {
+			std::size_t shift = pass * RadixSorter::radix_bits;
+			// Count the digits in each block.  Histograms are stored digit-major so an exclusive scan yields every block's output offset per digit.
+			this->q.parallel_for(
+				{ block_count },
+				[source_keys, count, block_count, shift, histograms = this->histograms.data()](std::size_t block) {
+					std::uint32_t counts[RadixSorter::radix_size] = {};
+					std::size_t end = std::min(count, (block + 1) * RadixSorter::block_size);
+					for (std::size_t i = block * RadixSorter::block_size; i < end; ++i) {
+						++counts[(source_keys[i] >> shift) & (RadixSorter::radix_size - 1)];
+					}
+					for (std::size_t digit = 0; digit < RadixSorter::radix_size; ++digit) {
+						histograms[digit * block_count + block] = counts[digit];
+					}
+				}
+			).wait();
+			// Scan each digit's row of block counts in parallel.
+			this->q.parallel_for(
+				{ RadixSorter::radix_size },
+				[block_count, histograms = this->histograms.data(), digit_offsets = this->digit_offsets.data()](std::size_t digit) {
+					std::uint32_t sum = 0;
+					for (std::size_t block = 0; block < block_count; ++block) {
+						std::uint32_t value = histograms[digit * block_count + block];
+						histograms[digit * block_count + block] = sum;
+						sum += value;
+					}
+					digit_offsets[digit] = sum;
+				}
+			).wait();
+			// Scan the per-digit totals.
+			this->q.single_task([digit_offsets = this->digit_offsets.data()]() {
+				std::uint32_t sum = 0;
+				for (std::size_t digit = 0; digit < RadixSorter::radix_size; ++digit) {
+					std::uint32_t value = digit_offsets[digit];
+					digit_offsets[digit] = sum;
+					sum += value;
+				}
+			}).wait();
+			// Scatter each block in order, which keeps the sort stable.
+			this->q.parallel_for(
+				{ block_count },
+				[
+					source_keys, source_values, destination_keys, destination_values, count, block_count, shift,
+					histograms = this->histograms.data(), digit_offsets = this->digit_offsets.data()
+				](std::size_t block) {
+					std::uint32_t offsets[RadixSorter::radix_size];
+					for (std::size_t digit = 0; digit < RadixSorter::radix_size; ++digit) {
+						offsets[digit] = digit_offsets[digit] + histograms[digit * block_count + block];
+					}
+					std::size_t end = std::min(count, (block + 1) * RadixSorter::block_size);
+					for (std::size_t i = block * RadixSorter::block_size; i < end; ++i) {
+						std::uint32_t position = offsets[(source_keys[i] >> shift) & (RadixSorter::radix_size - 1)]++;
+						destination_keys[position] = source_keys[i];
+						destination_values[position] = source_values[i];
+					}
+				}
+			).wait();
+			std::swap(source_keys, destination_keys);
+			std::swap(source_values, destination_values);
+		}
+	}
+
+private:
+	sycl::queue& q;
+
+	Shared<Key, SharedAllocator<Key>> key_scratch;
+	Shared<std::uint32_t, SharedAllocator<std::uint32_t>> value_scratch;
+	Shared<std::uint32_t, SharedAllocator<std::uint32_t>> histograms;
+	Shared<std::uint32_t, SharedAllocator<std::uint32_t>> digit_offsets;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,203 @@
+#ifndef GI_BAH8454_RAY_PACKET
+#define GI_BAH8454_RAY_PACKET
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include "../util.hpp"
+#include "../ray.hpp"
+#include "aabb.hpp"
+#include "bvh_node.hpp"
+#include "wide_bvh.hpp"
+
+/// @brief Up to size rays traced through a binary BVH together, one ray per vector lane.
+/// Packets pay off for coherent rays (primary rays of a pixel tile): every node is fetched once for the whole packet and its box is tested against all lanes at once.
+template <std::size_t size>
+class RayPacket {
+public:
+	static constexpr std::size_t lane_count = size;
+
+	/// @brief Gathers count (at most size) rays.  Unused lanes never hit anything.
+	RayPacket(const Ray* rays, const std::uint32_t* ray_indices, std::size_t count) : count{ count } {
+		for (std::size_t lane = 0; lane < size; ++lane) {
+			if (lane >= count) {
+				for (int axis = 0; axis < 3; ++axis) {
+					this->origin[axis][lane] = 0;
+					this->inverse_direction[axis][lane] = 0;
+					this->shear[axis][lane] = 0;
+				}
+				this->maximum_distance[lane] = -std::numeric_limits<Real>::infinity();
+				continue;
+			}
+			const Ray& ray = rays[ray_indices[lane]];
+			this->rays[lane] = &ray;
+			Vector3 inverse_direction = ray.direction.cwiseInverse();
+			for (int axis = 0; axis < 3; ++axis) {
+				this->origin[axis][lane] = ray.origin[axis];
+				this->inverse_direction[axis][lane] = inverse_direction[axis];
+				this->shear[axis][lane] = ray.shear[axis];
+			}
+			this->maximum_distance[lane] = std::numeric_limits<Real>::infinity();
+		}
+		// Vectorized watertight triangle tests need every lane to use the same axis permutation.
+		this->common_axes = count > 0;
+		for (std::size_t lane = 0; lane < count; ++lane) {
+			if (this->rays[lane]->axes != this->rays[0]->axes) { this->common_axes = false; }
+		}
+		if (this->common_axes) { this->axes = this->rays[0]->axes; }
+		// The frustum test is only valid when the lanes share an origin and, per axis, the sign of their direction.
+		this->coherent = count > 0;
+		for (std::size_t lane = 0; lane < count && this->coherent; ++lane) {
+			for (int axis = 0; axis < 3; ++axis) {
+				Real inverse = this->inverse_direction[axis][lane];
+				bool same_sign = (inverse < 0) == (this->inverse_direction[axis][0] < 0);
+				if (this->origin[axis][lane] != this->origin[axis][0] || !same_sign || !std::isfinite(inverse)) {
+					this->coherent = false;
+				}
+			}
+		}
+		if (this->coherent) {
+			for (int axis = 0; axis < 3; ++axis) {
+				this->frustum_origin[axis] = this->origin[axis][0];
+				this->frustum_minimum[axis] = this->inverse_direction[axis][0];
+				this->frustum_maximum[axis] = this->inverse_direction[axis][0];
+				for (std::size_t lane = 1; lane < count; ++lane) {
+					this->frustum_minimum[axis] = std::min(this->frustum_minimum[axis], this->inverse_direction[axis][lane]);
+					this->frustum_maximum[axis] = std::max(this->frustum_maximum[axis], this->inverse_direction[axis][lane]);
+				}
+			}
+		}
+	}
+
+	/// @brief Slab test of every lane against one box.
+	/// @return Per-lane entry distances; lanes that miss (or are further than their maximum distance) hold infinity.
+	RealVector<size> intersects(const AABB& box) const {
+		RealVector<size> t_near = RealVector<size>{};
+		RealVector<size> t_far = this->maximum_distance;
+		for (int axis = 0; axis < 3; ++axis) {
+			RealVector<size> t0 = (box.minimum[axis] - this->origin[axis]) * this->inverse_direction[axis];
+			RealVector<size> t1 = (box.maximum[axis] - this->origin[axis]) * this->inverse_direction[axis];
+			t_near = vector_max(t_near, vector_min(t0, t1));
+			t_far = vector_min(t_far, vector_max(t0, t1));
+		}
+		return t_near <= t_far ? t_near : RealVector<size>{} + std::numeric_limits<Real>::infinity();
+	}
+
+	/// @brief Conservative frustum test: true only if no lane can hit the box.
+	/// Bounds each lane's slab distances with interval arithmetic over the range of inverse directions, so a whole subtree is culled with one scalar test.
+	bool frustum_misses(const AABB& box) const {
+		if (!this->coherent) { return false; }
+		Real t_near = 0;
+		Real t_far = this->farthest;
+		for (int axis = 0; axis < 3; ++axis) {
+			Real near_offset = box.minimum[axis] - this->frustum_origin[axis];
+			Real far_offset = box.maximum[axis] - this->frustum_origin[axis];
+			Real t0 = near_offset * this->frustum_minimum[axis];
+			Real t1 = near_offset * this->frustum_maximum[axis];
+			Real t2 = far_offset * this->frustum_minimum[axis];
+			Real t3 = far_offset * this->frustum_maximum[axis];
+			t_near = std::max(t_near, std::min(std::min(t0, t1), std::min(t2, t3)));
+			t_far = std::min(t_far, std::max(std::max(t0, t1), std::max(t2, t3)));
+		}
+		return t_near > t_far;
+	}
+
+	/// @brief Refreshes the distance the frustum test culls against after lanes found closer hits.
+	void update_farthest() {
+		this->farthest = -std::numeric_limits<Real>::infinity();
+		for (std::size_t lane = 0; lane < this->count; ++lane) {
+			this->farthest = std::max(this->farthest, this->maximum_distance[lane]);
+		}
+	}
+
+	std::size_t count;
+	Array<const Ray*, size> rays;
+	RealVector<size> origin[3];
+	RealVector<size> inverse_direction[3];
+	// Distance of the closest hit of every lane so far.
+	RealVector<size> maximum_distance;
+
+	// Axis permutation shared by all lanes (if common_axes) and per-lane shear, for watertight triangle tests.
+	bool common_axes;
+	Array<int, 3> axes{ 0, 1, 2 };
+	RealVector<size> shear[3];
+
+	// Shared origin and range of inverse directions of coherent packets, for frustum culling.
+	bool coherent;
+	Vector3 frustum_origin;
+	Vector3 frustum_minimum;
+	Vector3 frustum_maximum;
+	Real farthest = std::numeric_limits<Real>::infinity();
+};
+
+/// @brief Result of intersecting every lane of a packet with one primitive.
+template <std::size_t size>
+class HitPacket {
+public:
+	// Lanes that miss hold infinity.
+	RealVector<size> distance;
+	RealVector<size> barycentric[3];
+};
+
+/// @brief Traverses a binary BVH with a whole packet, front to back for the packet as a whole.
+/// Children are tested against every lane at once after a frustum test; leaves are intersected only by the lanes that reach them.
+/// @param intersect Callable taking a primitive index and the lanes' entry distances into its leaf (infinity for lanes that miss the leaf).
+/// It intersects the primitive with those lanes, lowers their maximum distances on closer hits and returns whether any lane got closer.
+template <std::size_t size, typename Intersector>
+inline void traverse_bvh_packet(
+	const BVHNode* nodes,
+	std::size_t node_count,
+	const std::uint32_t* indices,
+	RayPacket<size>& packet,
+	Intersector&& intersect
+) {
+	if (node_count == 0 || packet.count == 0) { return; }
+	auto any_lane = [](const RealVector<size>& distances) {
+		for (std::size_t lane = 0; lane < size; ++lane) {
+			if (distances[lane] != std::numeric_limits<Real>::infinity()) { return true; }
+		}
+		return false;
+	};
+	// Smallest entry distance over the lanes that hit, which orders the children.
+	auto nearest_lane = [](const RealVector<size>& distances) {
+		Real nearest = std::numeric_limits<Real>::infinity();
+		for (std::size_t lane = 0; lane < size; ++lane) {
+			nearest = std::min(nearest, distances[lane]);
+		}
+		return nearest;
+	};
+	Array<std::uint32_t, bvh_stack_size> stack;
+	std::size_t stack_size = 0;
+	if (!any_lane(packet.intersects(nodes[0].bounds))) { return; }
+	stack[stack_size++] = 0;
+	while (stack_size > 0) {
+		const BVHNode& node = nodes[stack[--stack_size]];
+		if (node.is_leaf()) {
+			RealVector<size> distances = packet.intersects(node.bounds);
+			bool closer = false;
+			for (std::uint32_t i = node.left; i < node.left + node.count; ++i) {
+				closer |= intersect(indices[i], distances);
+			}
+			if (closer) { packet.update_farthest(); }
+			continue;
+		}
+		const BVHNode& left = nodes[node.left];
+		const BVHNode& right = nodes[node.right];
+		Real left_distance = std::numeric_limits<Real>::infinity();
+		Real right_distance = std::numeric_limits<Real>::infinity();
+		if (!packet.frustum_misses(left.bounds)) { left_distance = nearest_lane(packet.intersects(left.bounds)); }
+		if (!packet.frustum_misses(right.bounds)) { right_distance = nearest_lane(packet.intersects(right.bounds)); }
+		// Visit first the child the packet reaches first.
+		std::uint32_t near_child = node.left;
+		std::uint32_t far_child = node.right;
+		if (right_distance < left_distance) {
+			std::swap(near_child, far_child);
+			std::swap(left_distance, right_distance);
+		}
+		if (right_distance != std::numeric_limits<Real>::infinity()) { stack[stack_size++] = far_child; }
+		if (left_distance != std::numeric_limits<Real>::infinity()) { stack[stack_size++] = near_child; }
+	}
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,105 @@
+#ifndef GI_BAH8454_RAY_STREAM
+#define GI_BAH8454_RAY_STREAM
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "../util.hpp"
+#include "../ray.hpp"
+#include "aabb.hpp"
+#include "bvh_node.hpp"
+
+/// @brief Traverses a binary BVH with an arbitrary batch of rays (Wald et al. 2007, Barringer and Akenine-Möller 2014).
+/// Each node is visited once with the list of rays that reached its parent; the rays that hit each child are filtered into new lists, so rays that diverge (after reflection or transmission) simply drop out of lists instead of idling in packet lanes.
+/// Runs on the host: the lists live in a growing scratch buffer.
+/// @param rays Rays of the batch, indexed by ray_indices.
+/// @param maximum_distances Per-ray distance of the closest hit so far (indexed like rays); nodes and hits further away are culled and it is updated with every closer hit.
+/// @param intersect Callable taking a ray index and a primitive index and returning the hit distance if it is closer than the ray's maximum distance (or an empty Optional).
+/// @param any_hit Stop tracing a ray at its first hit (shadow rays).
+template <typename Intersector>
+inline void traverse_bvh_stream(
+	const BVHNode* nodes,
+	std::size_t node_count,
+	const std::uint32_t* indices,
+	const Ray* rays,
+	const std::uint32_t* ray_indices,
+	std::size_t ray_count,
+	Real* maximum_distances,
+	Intersector&& intersect,
+	bool any_hit = false
+) {
+	if (node_count == 0 || ray_count == 0) { return; }
+	// Node, first entry of its ray list and the list's length.
+	class Entry {
+	public:
+		std::uint32_t node;
+		std::size_t begin;
+		std::size_t count;
+	};
+	std::vector<std::uint32_t> lists;
+	std::vector<Entry> stack;
+	std::vector<Vector3> inverse_directions(ray_count);
+	// Rays of any-hit batches that already hit something.
+	std::vector<bool> done(any_hit ? ray_count : 0, false);
+	lists.reserve(ray_count * 4);
+	stack.reserve(bvh_stack_size);
+	// Appends the rays of a list that hit a box, returning the sum of their entry distances.
+	auto filter = [&](std::size_t begin, std::size_t count, const AABB& box) {
+		Real total = 0;
+		for (std::size_t i = begin; i < begin + count; ++i) {
+			std::uint32_t r = lists[i];
+			if (any_hit && done[r]) { continue; }
+			Real distance = box.intersects(rays[ray_indices[r]], inverse_directions[r], maximum_distances[ray_indices[r]]);
+			if (distance == std::numeric_limits<Real>::infinity()) { continue; }
+			lists.push_back(r);
+			total += distance;
+		}
+		return total;
+	};
+	// Rays are referred to by their position in ray_indices so the scratch arrays can be dense.
+	for (std::uint32_t r = 0; r < ray_count; ++r) {
+		inverse_directions[r] = rays[ray_indices[r]].direction.cwiseInverse();
+		lists.push_back(r);
+	}
+	std::size_t root_begin = lists.size();
+	filter(0, ray_count, nodes[0].bounds);
+	if (lists.size() > root_begin) { stack.push_back({ 0, root_begin, lists.size() - root_begin }); }
+	while (!stack.empty()) {
+		Entry entry = stack.back();
+		stack.pop_back();
+		// Drop the lists of finished subtrees.  The sibling pushed with this entry may sit above it in the buffer.
+		std::size_t end = entry.begin + entry.count;
+		if (!stack.empty()) { end = std::max(end, stack.back().begin + stack.back().count); }
+		lists.resize(end);
+		const BVHNode& node = nodes[entry.node];
+		if (node.is_leaf()) {
+			for (std::uint32_t i = node.left; i < node.left + node.count; ++i) {
+				for (std::size_t j = entry.begin; j < entry.begin + entry.count; ++j) {
+					std::uint32_t r = lists[j];
+					if (any_hit && done[r]) { continue; }
+					if (auto distance = intersect(ray_indices[r], indices[i])) {
+						maximum_distances[ray_indices[r]] = *distance;
+						if (any_hit) { done[r] = true; }
+					}
+				}
+			}
+			continue;
+		}
+		std::size_t left_begin = lists.size();
+		Real left_total = filter(entry.begin, entry.count, nodes[node.left].bounds);
+		std::size_t right_begin = lists.size();
+		Real right_total = filter(entry.begin, entry.count, nodes[node.right].bounds);
+		Entry left{ node.left, left_begin, right_begin - left_begin };
+		Entry right{ node.right, right_begin, lists.size() - right_begin };
+		// Visit the child that is nearer on average first, so its hits cull more of the other one.
+		bool left_first = left.count > 0 && (right.count == 0 || left_total * right.count <= right_total * left.count);
+		Entry& first = left_first ? left : right;
+		Entry& second = left_first ? right : left;
+		if (second.count > 0) { stack.push_back(second); }
+		if (first.count > 0) { stack.push_back(first); }
+	}
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,140 @@
+#ifndef GI_BAH8454_SAH_BUILDER
+#define GI_BAH8454_SAH_BUILDER
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <limits>
+
+#include "../util.hpp"
+#include "aabb.hpp"
+#include "bvh_node.hpp"
+
+/// @brief Serial top-down BVH builder that picks splits with the binned surface area heuristic.
+/// Slower to build than the LBVH but produces higher quality trees, so it is the reference for static scenes.
+class SAHBuilder {
+public:
+	static constexpr std::size_t bin_count = 16;
+
+	void build(
+		const AABB* bounds,
+		std::size_t count,
+		std::size_t maximum_leaf_size,
+		Shared<BVHNode, SharedAllocator<BVHNode>>& nodes,
+		Shared<std::uint32_t, SharedAllocator<std::uint32_t>>& indices
+	) {
+		nodes.clear();
+		indices.resize(count);
+		if (count == 0) { return; }
+		this->centroids.resize(count);
+		for (std::size_t i = 0; i < count; ++i) {
+			indices[i] = static_cast<std::uint32_t>(i);
+			this->centroids[i] = bounds[i].centroid();
+		}
+		nodes.reserve(2 * count - 1);
+		nodes.push_back(BVHNode{});
+		// Nodes waiting to be split, as (node, first, count).
+		std::vector<Tuple<std::uint32_t, std::uint32_t, std::uint32_t>> work{ { 0, 0, static_cast<std::uint32_t>(count) } };
+		while (!work.empty()) {
+			auto [node_index, first, node_count] = work.back();
+			work.pop_back();
+			AABB node_bounds{};
+			AABB centroid_bounds{};
+			for (std::uint32_t i = first; i < first + node_count; ++i) {
+				node_bounds.grow(bounds[indices[i]]);
+				centroid_bounds.grow(this->centroids[indices[i]]);
+			}
+			nodes[node_index].bounds = node_bounds;
+			std::uint32_t split = this->find_split(bounds, indices.data(), first, node_count, node_bounds, centroid_bounds, maximum_leaf_size);
+			if (split == 0) {
+				// Make a leaf.
+				nodes[node_index].left = first;
+				nodes[node_index].count = node_count;
+				continue;
+			}
+			std::uint32_t left = static_cast<std::uint32_t>(nodes.size());
+			nodes.push_back(BVHNode{});
+			nodes.push_back(BVHNode{});
+			nodes[left].parent = node_index;
+			nodes[left + 1].parent = node_index;
+			nodes[node_index].left = left;
+			nodes[node_index].right = left + 1;
+			nodes[node_index].count = 0;
+			work.push_back({ left, first, split });
+			work.push_back({ left + 1, first + split, node_count - split });
+		}
+	}
+
+private:
+	/// @brief Partitions indices[first, first + count) along the cheapest binned split.
+	/// @return The number of primitives in the left child, or 0 if the node should become a leaf.
+	std::uint32_t find_split(
+		const AABB* bounds,
+		std::uint32_t* indices,
+		std::uint32_t first,
+		std::uint32_t count,
+		const AABB& node_bounds,
+		const AABB& centroid_bounds,
+		std::size_t maximum_leaf_size
+	) {
+		if (count <= 1) { return 0; }
+		Real best_cost = std::numeric_limits<Real>::infinity();
+		int best_axis = -1;
+		std::size_t best_bin = 0;
+		Vector3 extent = centroid_bounds.extent();
+		for (int axis = 0; axis < 3; ++axis) {
+			if (extent[axis] <= 0) { continue; }
+			Array<AABB, SAHBuilder::bin_count> bin_bounds{};
+			Array<std::uint32_t, SAHBuilder::bin_count> bin_counts{};
+			for (std::uint32_t i = first; i < first + count; ++i) {
+				std::size_t bin = this->get_bin(this->centroids[indices[i]][axis], centroid_bounds.minimum[axis], extent[axis]);
+				bin_bounds[bin].grow(bounds[indices[i]]);
+				++bin_counts[bin];
+			}
+			// Sweep from the right to get the cost of every right partition, then from the left to evaluate each plane.
+			Array<Real, SAHBuilder::bin_count> right_costs{};
+			AABB right_bounds{};
+			std::uint32_t right_count = 0;
+			for (std::size_t bin = SAHBuilder::bin_count - 1; bin > 0; --bin) {
+				right_bounds.grow(bin_bounds[bin]);
+				right_count += bin_counts[bin];
+				right_costs[bin] = right_count * right_bounds.surface_area();
+			}
+			AABB left_bounds{};
+			std::uint32_t left_count = 0;
+			for (std::size_t bin = 0; bin < SAHBuilder::bin_count - 1; ++bin) {
+				left_bounds.grow(bin_bounds[bin]);
+				left_count += bin_counts[bin];
+				Real cost = left_count * left_bounds.surface_area() + right_costs[bin + 1];
+				if (left_count > 0 && left_count < count && cost < best_cost) {
+					best_cost = cost;
+					best_axis = axis;
+					best_bin = bin;
+				}
+			}
+		}
+		// Keep the node as a leaf when splitting doesn't beat intersecting everything.
+		Real leaf_cost = count * node_bounds.surface_area();
+		if (count <= maximum_leaf_size && (best_axis < 0 || best_cost >= leaf_cost)) {
+			return 0;
+		}
+		std::uint32_t* begin = indices + first;
+		std::uint32_t* end = begin + count;
+		if (best_axis < 0) {
+			// All centroids coincide, so split the range in half.
+			return count / 2;
+		}
+		std::uint32_t* middle = std::partition(begin, end, [&](std::uint32_t index) {
+			return this->get_bin(this->centroids[index][best_axis], centroid_bounds.minimum[best_axis], extent[best_axis]) <= best_bin;
+		});
+		return static_cast<std::uint32_t>(middle - begin);
+	}
+
+	static std::size_t get_bin(Real centroid, Real minimum, Real extent) {
+		return std::min(static_cast<std::size_t>(SAHBuilder::bin_count * ((centroid - minimum) / extent)), SAHBuilder::bin_count - 1);
+	}
+
+	std::vector<Vector3> centroids;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,270 @@
+#ifndef GI_BAH8454_SBVH_BUILDER
+#define GI_BAH8454_SBVH_BUILDER
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <limits>
+
+#include "../util.hpp"
+#include "aabb.hpp"
+#include "bvh_node.hpp"
+
+/// @brief Serial top-down builder that considers spatial splits as well as object splits (Stich et al. 2009).
+/// A spatial split clips the primitives straddling the plane into both children, which pays off for long, thin triangles whose boxes overlap heavily.
+/// Primitives can therefore be referenced by more than one leaf; the number of extra references is capped by a budget.
+class SBVHBuilder {
+public:
+	static constexpr std::size_t bin_count = 16;
+	// Spatial splits are only tried when the children of the best object split overlap by more than this fraction of the root's surface area.
+	static constexpr Real overlap_threshold = 1e-5;
+
+	/// @param clip Callable taking a primitive index, an axis and a slab [minimum, maximum] along it, returning the bounds of the part of the primitive inside.
+	/// @param duplication_budget Extra references allowed, as a fraction of count.
+	template <typename Clipper>
+	void build(
+		const AABB* bounds,
+		std::size_t count,
+		std::size_t maximum_leaf_size,
+		Real duplication_budget,
+		Clipper&& clip,
+		Shared<BVHNode, SharedAllocator<BVHNode>>& nodes,
+		Shared<std::uint32_t, SharedAllocator<std::uint32_t>>& indices
+	) {
+		nodes.clear();
+		indices.clear();
+		if (count == 0) { return; }
+		std::vector<Reference> references(count);
+		AABB root_bounds{};
+		for (std::size_t i = 0; i < count; ++i) {
+			references[i] = { static_cast<std::uint32_t>(i), bounds[i] };
+			root_bounds.grow(bounds[i]);
+		}
+		this->root_area = root_bounds.surface_area();
+		this->reference_count = count;
+		this->reference_budget = count + static_cast<std::size_t>(duplication_budget * count);
+		nodes.push_back(BVHNode{});
+		std::vector<Work> work{};
+		work.push_back({ 0, std::move(references) });
+		while (!work.empty()) {
+			Work current = std::move(work.back());
+			work.pop_back();
+			AABB node_bounds{};
+			for (const Reference& reference : current.references) {
+				node_bounds.grow(reference.bounds);
+			}
+			nodes[current.node].bounds = node_bounds;
+			std::vector<Reference> left{};
+			std::vector<Reference> right{};
+			if (!this->split(current.references, node_bounds, maximum_leaf_size, clip, left, right)) {
+				// Make a leaf.
+				nodes[current.node].left = static_cast<std::uint32_t>(indices.size());
+				nodes[current.node].count = static_cast<std::uint32_t>(current.references.size());
+				for (const Reference& reference : current.references) {
+					indices.push_back(reference.index);
+				}
+				continue;
+			}
+			this->reference_count += left.size() + right.size() - current.references.size();
+			std::uint32_t left_index = static_cast<std::uint32_t>(nodes.size());
+			nodes.push_back(BVHNode{});
+			nodes.push_back(BVHNode{});
+			nodes[left_index].parent = current.node;
+			nodes[left_index + 1].parent = current.node;
+			nodes[current.node].left = left_index;
+			nodes[current.node].right = left_index + 1;
+			nodes[current.node].count = 0;
+			work.push_back({ left_index, std::move(left) });
+			work.push_back({ left_index + 1, std::move(right) });
+		}
+	}
+
+private:
+	class Reference {
+	public:
+		std::uint32_t index;
+		AABB bounds;
+	};
+
+	class Work {
+	public:
+		std::uint32_t node;
+		std::vector<Reference> references;
+	};
+
+	class Split {
+	public:
+		Real cost = std::numeric_limits<Real>::infinity();
+		int axis = -1;
+		Real position = 0;
+		AABB left_bounds{};
+		AABB right_bounds{};
+	};
+
+	/// @brief Distributes references into left and right along the cheapest object or spatial split.
+	/// @return False if the node should become a leaf.
+	template <typename Clipper>
+	bool split(
+		const std::vector<Reference>& references,
+		const AABB& node_bounds,
+		std::size_t maximum_leaf_size,
+		Clipper& clip,
+		std::vector<Reference>& left,
+		std::vector<Reference>& right
+	) {
+		std::size_t count = references.size();
+		if (count <= 1) { return false; }
+		Split object_split = this->find_object_split(references);
+		Split spatial_split{};
+		Real overlap = object_split.left_bounds.intersection(object_split.right_bounds).surface_area();
+		if ((object_split.axis < 0 || overlap > SBVHBuilder::overlap_threshold * this->root_area) && this->reference_count < this->reference_budget) {
+			spatial_split = this->find_spatial_split(references, node_bounds, clip);
+		}
+		Real leaf_cost = count * node_bounds.surface_area();
+		Real best_cost = std::min(object_split.cost, spatial_split.cost);
+		if (count <= maximum_leaf_size && best_cost >= leaf_cost) {
+			return false;
+		}
+		if (spatial_split.cost < object_split.cost) {
+			int axis = spatial_split.axis;
+			Real plane = spatial_split.position;
+			for (const Reference& reference : references) {
+				if (reference.bounds.maximum[axis] <= plane) {
+					left.push_back(reference);
+				} else if (reference.bounds.minimum[axis] >= plane) {
+					right.push_back(reference);
+				} else {
+					// Straddling references are clipped into both children.
+					AABB left_bounds = clip(reference.index, axis, reference.bounds.minimum[axis], plane).intersection(reference.bounds);
+					AABB right_bounds = clip(reference.index, axis, plane, reference.bounds.maximum[axis]).intersection(reference.bounds);
+					if (!left_bounds.is_empty()) { left.push_back({ reference.index, left_bounds }); }
+					if (!right_bounds.is_empty()) { right.push_back({ reference.index, right_bounds }); }
+				}
+			}
+			// Duplicated references count against the budget, so repeated spatial splits of the same references always terminate.
+			if (!left.empty() && !right.empty()) {
+				return true;
+			}
+			// Clipping emptied one side, fall back to the object split.
+			left.clear();
+			right.clear();
+		}
+		if (object_split.axis >= 0) {
+			int axis = object_split.axis;
+			for (const Reference& reference : references) {
+				(reference.bounds.centroid()[axis] < object_split.position ? left : right).push_back(reference);
+			}
+			if (!left.empty() && !right.empty()) { return true; }
+			left.clear();
+			right.clear();
+		}
+		if (count <= maximum_leaf_size) { return false; }
+		// All centroids coincide, so split the list in half.
+		left.assign(references.begin(), references.begin() + count / 2);
+		right.assign(references.begin() + count / 2, references.end());
+		return true;
+	}
+
+	Split find_object_split(const std::vector<Reference>& references) {
+		Split best{};
+		AABB centroid_bounds{};
+		for (const Reference& reference : references) {
+			centroid_bounds.grow(reference.bounds.centroid());
+		}
+		Vector3 extent = centroid_bounds.extent();
+		for (int axis = 0; axis < 3; ++axis) {
+			if (extent[axis] <= 0) { continue; }
+			Array<AABB, SBVHBuilder::bin_count> bin_bounds{};
+			Array<std::uint32_t, SBVHBuilder::bin_count> bin_counts{};
+			for (const Reference& reference : references) {
+				std::size_t bin = SBVHBuilder::get_bin(reference.bounds.centroid()[axis], centroid_bounds.minimum[axis], extent[axis]);
+				bin_bounds[bin].grow(reference.bounds);
+				++bin_counts[bin];
+			}
+			this->sweep(bin_bounds, bin_counts, bin_counts, axis, [&](std::size_t bin) {
+				return centroid_bounds.minimum[axis] + extent[axis] * (bin + 1) / SBVHBuilder::bin_count;
+			}, best);
+		}
+		return best;
+	}
+
+	template <typename Clipper>
+	Split find_spatial_split(const std::vector<Reference>& references, const AABB& node_bounds, Clipper& clip) {
+		Split best{};
+		Vector3 extent = node_bounds.extent();
+		for (int axis = 0; axis < 3; ++axis) {
+			if (extent[axis] <= 0) { continue; }
+			Real bin_width = extent[axis] / SBVHBuilder::bin_count;
+			Array<AABB, SBVHBuilder::bin_count> bin_bounds{};
+			// References are counted where they enter (left side) and where they leave (right side).
+			Array<std::uint32_t, SBVHBuilder::bin_count> entries{};
+			Array<std::uint32_t, SBVHBuilder::bin_count> exits{};
+			for (const Reference& reference : references) {
+				std::size_t first = SBVHBuilder::get_bin(reference.bounds.minimum[axis], node_bounds.minimum[axis], extent[axis]);
+				std::size_t last = SBVHBuilder::get_bin(reference.bounds.maximum[axis], node_bounds.minimum[axis], extent[axis]);
+				++entries[first];
+				++exits[last];
+				if (first == last) {
+					bin_bounds[first].grow(reference.bounds);
+					continue;
+				}
+				for (std::size_t bin = first; bin <= last; ++bin) {
+					Real minimum = node_bounds.minimum[axis] + bin * bin_width;
+					Real maximum = bin == SBVHBuilder::bin_count - 1 ? node_bounds.maximum[axis] : minimum + bin_width;
+					bin_bounds[bin].grow(clip(reference.index, axis, minimum, maximum).intersection(reference.bounds));
+				}
+			}
+			this->sweep(bin_bounds, entries, exits, axis, [&](std::size_t bin) {
+				return node_bounds.minimum[axis] + (bin + 1) * bin_width;
+			}, best);
+		}
+		return best;
+	}
+
+	/// @brief Evaluates every plane between bins, updating best if one is cheaper.
+	template <typename Position>
+	void sweep(
+		const Array<AABB, SBVHBuilder::bin_count>& bin_bounds,
+		const Array<std::uint32_t, SBVHBuilder::bin_count>& left_counts,
+		const Array<std::uint32_t, SBVHBuilder::bin_count>& right_counts,
+		int axis,
+		Position&& position,
+		Split& best
+	) {
+		Array<AABB, SBVHBuilder::bin_count> right_bounds{};
+		Array<std::uint32_t, SBVHBuilder::bin_count> right_totals{};
+		AABB accumulated_bounds{};
+		std::uint32_t accumulated_count = 0;
+		for (std::size_t bin = SBVHBuilder::bin_count - 1; bin > 0; --bin) {
+			accumulated_bounds.grow(bin_bounds[bin]);
+			accumulated_count += right_counts[bin];
+			right_bounds[bin] = accumulated_bounds;
+			right_totals[bin] = accumulated_count;
+		}
+		AABB left_bounds{};
+		std::uint32_t left_count = 0;
+		for (std::size_t bin = 0; bin < SBVHBuilder::bin_count - 1; ++bin) {
+			left_bounds.grow(bin_bounds[bin]);
+			left_count += left_counts[bin];
+			if (left_count == 0 || right_totals[bin + 1] == 0) { continue; }
+			Real cost = left_count * left_bounds.surface_area() + right_totals[bin + 1] * right_bounds[bin + 1].surface_area();
+			if (cost < best.cost) {
+				best.cost = cost;
+				best.axis = axis;
+				best.position = position(bin);
+				best.left_bounds = left_bounds;
+				best.right_bounds = right_bounds[bin + 1];
+			}
+		}
+	}
+
+	static std::size_t get_bin(Real value, Real minimum, Real extent) {
+		return std::min(static_cast<std::size_t>(std::max(SBVHBuilder::bin_count * ((value - minimum) / extent), 0_r)), SBVHBuilder::bin_count - 1);
+	}
+
+	Real root_area = 0;
+	std::size_t reference_count = 0;
+	std::size_t reference_budget = 0;
+};
+
+#endif
\ No newline at end of file
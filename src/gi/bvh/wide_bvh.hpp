@@ -0,0 +1,189 @@
+#ifndef GI_BAH8454_WIDE_BVH
+#define GI_BAH8454_WIDE_BVH
+
+#include <cstdint>
+#include <vector>
+#include <limits>
+
+#include "../util.hpp"
+#include "../ray.hpp"
+#include "aabb.hpp"
+#include "bvh_node.hpp"
+
+// Eigen is built with EIGEN_DONT_VECTORIZE, so wide nodes use compiler vector extensions directly.
+// One lane per child; the compiler lowers operations to SSE/AVX2/AVX-512 on the host and scalarizes them on devices without vector units.
+template <std::size_t width>
+class RealVectorType {
+public:
+	typedef Real type __attribute__((vector_size(sizeof(Real) * width)));
+};
+
+template <std::size_t width>
+using RealVector = typename RealVectorType<width>::type;
+
+template <typename V>
+inline V vector_min(V a, V b) {
+	return a < b ? a : b;
+}
+
+template <typename V>
+inline V vector_max(V a, V b) {
+	return a > b ? a : b;
+}
+
+/// @brief A node with up to width children whose bounds are stored in structure-of-arrays form so one ray tests all of them at once.
+template <std::size_t width>
+class WideBVHNode {
+public:
+	static constexpr std::size_t lane_count = width;
+	static constexpr std::uint32_t no_child = std::numeric_limits<std::uint32_t>::max();
+
+	/// @brief Slab test of the ray against every child.
+	/// @return Per-lane entry distances; lanes that miss (or are further than maximum_distance) hold infinity.
+	RealVector<width> intersects(const Ray& ray, const Vector3& inverse_direction, Real maximum_distance) const {
+		RealVector<width> t_near = RealVector<width>{};
+		RealVector<width> t_far = RealVector<width>{} + maximum_distance;
+		for (int axis = 0; axis < 3; ++axis) {
+			RealVector<width> t0 = (this->minimum[axis] - ray.origin[axis]) * inverse_direction[axis];
+			RealVector<width> t1 = (this->maximum[axis] - ray.origin[axis]) * inverse_direction[axis];
+			t_near = vector_max(t_near, vector_min(t0, t1));
+			t_far = vector_min(t_far, vector_max(t0, t1));
+		}
+		return t_near <= t_far ? t_near : RealVector<width>{} + std::numeric_limits<Real>::infinity();
+	}
+
+	bool is_empty(std::size_t lane) const {
+		return this->children[lane] == WideBVHNode::no_child;
+	}
+
+	bool is_leaf(std::size_t lane) const {
+		return this->counts[lane] > 0;
+	}
+
+	// Child bounds, indexed by axis then lane.
+	RealVector<width> minimum[3];
+	RealVector<width> maximum[3];
+	// Interior children store the index of their wide node, leaves store the first entry of their range in the primitive index list.
+	Array<std::uint32_t, width> children;
+	// Number of primitives in a leaf child (0 for interior and empty children).
+	Array<std::uint32_t, width> counts;
+};
+
+/// @brief Collapses a binary hierarchy into one with width children per node by repeatedly opening the child with the largest surface area.
+template <std::size_t width>
+void collapse_bvh(const Shared<BVHNode, SharedAllocator<BVHNode>>& nodes, Shared<WideBVHNode<width>, SharedAllocator<WideBVHNode<width>>>& wide_nodes) {
+	wide_nodes.clear();
+	if (nodes.empty()) { return; }
+	wide_nodes.push_back(WideBVHNode<width>{});
+	// Wide nodes waiting to be filled, paired with the binary node they replace.
+	std::vector<Tuple<std::uint32_t, std::uint32_t>> work{ { 0, 0 } };
+	while (!work.empty()) {
+		auto [wide_index, binary_index] = work.back();
+		work.pop_back();
+		// Gather the children, opening interior ones until the node is full.
+		Array<std::uint32_t, width> candidates;
+		std::size_t candidate_count = 0;
+		if (nodes[binary_index].is_leaf()) {
+			candidates[candidate_count++] = binary_index;
+		} else {
+			candidates[candidate_count++] = nodes[binary_index].left;
+			candidates[candidate_count++] = nodes[binary_index].right;
+		}
+		while (candidate_count < width) {
+			std::size_t largest = width;
+			Real largest_area = -1;
+			for (std::size_t i = 0; i < candidate_count; ++i) {
+				const BVHNode& candidate = nodes[candidates[i]];
+				if (!candidate.is_leaf() && candidate.bounds.surface_area() > largest_area) {
+					largest = i;
+					largest_area = candidate.bounds.surface_area();
+				}
+			}
+			if (largest == width) { break; }
+			const BVHNode& opened = nodes[candidates[largest]];
+			candidates[largest] = opened.left;
+			candidates[candidate_count++] = opened.right;
+		}
+		// Fill the lanes.  Empty lanes get boxes at infinity, which every slab test misses.
+		WideBVHNode<width> wide_node{};
+		for (std::size_t lane = 0; lane < width; ++lane) {
+			if (lane >= candidate_count) {
+				for (int axis = 0; axis < 3; ++axis) {
+					wide_node.minimum[axis][lane] = std::numeric_limits<Real>::infinity();
+					wide_node.maximum[axis][lane] = std::numeric_limits<Real>::infinity();
+				}
+				wide_node.children[lane] = WideBVHNode<width>::no_child;
+				wide_node.counts[lane] = 0;
+				continue;
+			}
+			const BVHNode& child = nodes[candidates[lane]];
+			for (int axis = 0; axis < 3; ++axis) {
+				wide_node.minimum[axis][lane] = child.bounds.minimum[axis];
+				wide_node.maximum[axis][lane] = child.bounds.maximum[axis];
+			}
+			if (child.is_leaf()) {
+				wide_node.children[lane] = child.left;
+				wide_node.counts[lane] = child.count;
+			} else {
+				wide_node.children[lane] = static_cast<std::uint32_t>(wide_nodes.size());
+				wide_node.counts[lane] = 0;
+				wide_nodes.push_back(WideBVHNode<width>{});
+				work.push_back({ wide_node.children[lane], candidates[lane] });
+			}
+		}
+		wide_nodes[wide_index] = wide_node;
+	}
+}
+
+/// @brief Traverses a wide BVH (plain or compressed nodes) front to back.  See traverse_bvh for the meaning of the parameters.
+template <typename Node, typename Intersector>
+inline bool traverse_wide_bvh(
+	const Node* nodes,
+	std::size_t node_count,
+	const std::uint32_t* indices,
+	const Ray& ray,
+	Real& maximum_distance,
+	Intersector&& intersect,
+	bool any_hit = false
+) {
+	if (node_count == 0) { return false; }
+	Vector3 inverse_direction = ray.direction.cwiseInverse();
+	bool hit = false;
+	// Stack entries are (wide node, 0) for interior children and (first primitive, count) for leaves.
+	Array<Tuple<std::uint32_t, std::uint32_t>, bvh_stack_size * 2> stack;
+	std::size_t stack_size = 0;
+	stack[stack_size++] = { 0, 0 };
+	while (stack_size > 0) {
+		auto [index, count] = stack[--stack_size];
+		if (count > 0) {
+			for (std::uint32_t i = index; i < index + count; ++i) {
+				if (auto distance = intersect(indices[i])) {
+					maximum_distance = *distance;
+					hit = true;
+					if (any_hit) { return true; }
+				}
+			}
+			continue;
+		}
+		const Node& node = nodes[index];
+		auto distances = node.intersects(ray, inverse_direction, maximum_distance);
+		// Sort the children that were hit by distance so the nearest is popped first.
+		Array<std::size_t, Node::lane_count> lanes;
+		std::size_t hit_count = 0;
+		for (std::size_t lane = 0; lane < Node::lane_count; ++lane) {
+			if (distances[lane] == std::numeric_limits<Real>::infinity() || node.is_empty(lane)) { continue; }
+			std::size_t position = hit_count++;
+			while (position > 0 && distances[lanes[position - 1]] < distances[lane]) {
+				lanes[position] = lanes[position - 1];
+				--position;
+			}
+			lanes[position] = lane;
+		}
+		for (std::size_t i = 0; i < hit_count; ++i) {
+			stack[stack_size++] = { node.children[lanes[i]], node.counts[lanes[i]] };
+		}
+	}
+	return hit;
+}
+
+#endif
\ No newline at end of file
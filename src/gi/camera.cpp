@@ -15,6 +15,29 @@ Camera::Camera(sycl::queue& q, Camera::Info camera_info, FrameBuffer::Info frame
 	std::construct_at(this->film_plane);
 	// Construct the rays.
 	this->rays = sycl::malloc_shared<Ray>(sizeof(Ray) * this->ray_column_count * this->ray_row_count, this->q);
+	this->generate_rays();
+	// Construct the view matrix.
+	this->view = sycl::malloc_shared<Matrix3H>(sizeof(this->view), this->q);
+	this->look_at(camera_info.position, camera_info.center, camera_info.up);
+}
+
+Camera::~Camera() {
+	sycl::free(this->rays, this->q);
+	sycl::free(this->view, this->q);
+	sycl::free(this->film_plane, this->q);
+}
+
+/// Changes the number of rays, keeping the film plane and so the field of view.
+/// @param width Rays per row, at most the frame buffer width the camera was constructed with.
+/// @param height Rays per column, at most the frame buffer height the camera was constructed with.
+void Camera::resize(std::size_t width, std::size_t height) {
+	this->ray_column_count = width;
+	this->ray_row_count = height;
+	this->generate_rays();
+}
+
+/// Points a ray from the camera through each pixel of the film plane.
+void Camera::generate_rays() {
 	this->q.parallel_for(
 		{this->ray_column_count * this->ray_row_count},
 		[
@@ -33,15 +56,6 @@ Camera::Camera(sycl::queue& q, Camera::Info camera_info, FrameBuffer::Info frame
 			rays[pixel_y * ray_column_count + pixel_x] = { Vector3{ 0, 0, 0 }, direction };
 		}
 	).wait();
-	// Construct the view matrix.
-	this->view = sycl::malloc_shared<Matrix3H>(sizeof(this->view), this->q);
-	this->look_at(camera_info.position, camera_info.center, camera_info.up);
-}
-
-Camera::~Camera() {
-	sycl::free(this->rays, this->q);
-	sycl::free(this->view, this->q);
-	sycl::free(this->film_plane, this->q);
 }
 
 void Camera::look_at(const Vector3& position, const Vector3& center, const Vector3& up) {
@@ -99,4 +113,15 @@ Vector3 Camera::get_right_vector() const {
 /// @param distance The distance to translate. 
 void Camera::translate(const Vector3& direction, Real distance) {
 	this->set_position(this->get_position() - distance * direction);
+}
+
+/// Turns the camera about its position.
+/// @param yaw Radians to turn right, about the world's up axis so the horizon stays level.
+/// @param pitch Radians to look up, about the camera's right axis.
+void Camera::rotate(Real yaw, Real pitch) {
+	// Turning the camera turns the world the other way around it, so the rotation applies in camera coordinates, after the view matrix.
+	Vector3 world_up = (this->view->topLeftCorner<3, 3>() * Vector3{ 0, 1, 0 }).normalized();
+	Matrix3H rotation = Matrix3H::Identity();
+	rotation.topLeftCorner<3, 3>() = (Eigen::AngleAxis<Real>(-pitch, Vector3{ 1, 0, 0 }) * Eigen::AngleAxis<Real>(yaw, world_up)).toRotationMatrix();
+	*this->view = rotation * *this->view;
 }
\ No newline at end of file
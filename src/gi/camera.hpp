@@ -28,6 +28,8 @@ public:
 	Camera(const Camera&) = delete;
 	~Camera();
 
+	void resize(std::size_t width, std::size_t height);
+
 	void look_at(const Vector3& position, const Vector3& center, const Vector3& up);
 
 	void set_position(const Vector3& position); 
@@ -38,6 +40,7 @@ public:
 	Vector3 get_right_vector() const;
 
 	void translate(const Vector3& direction, Real distance);
+	void rotate(Real yaw, Real pitch);
 
 	sycl::queue& q;
 
@@ -49,6 +52,9 @@ public:
 	FilmPlane* film_plane;
 
 	Ray* rays;
+
+private:
+	void generate_rays();
 };
 
 #endif
\ No newline at end of file
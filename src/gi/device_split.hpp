@@ -0,0 +1,140 @@
+#ifndef GI_BAH8454_DEVICE_SPLIT
+#define GI_BAH8454_DEVICE_SPLIT
+
+// Include SYCL.
+#include <sycl/sycl.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "util.hpp"
+#include "partial_update.hpp"
+
+/// @brief Splits the tiles of each frame between several SYCL devices, each drawing its share with a copy of the scene.
+/// Shares follow the pixels per second each device drew in recent frames, so a fast GPU gets more of the frame than a slow one and the devices finish together.
+/// Only the wavefront integrator shades on the devices, though.  The packet, stream and single ray traversals shade on the host, so a device's share is drawn by a host thread of its own, its queue only transforming the scene and building the BVH, and the shares follow those threads' speed rather than the devices'.
+class DeviceSplit {
+public:
+	enum class Selection {
+		// The GPU selector's device alone.
+		single,
+		// Every device SYCL finds, such as several GPUs or a GPU and the CPU.
+		all,
+		// Several queues on the CPU, to try the split on machines without a GPU.
+		host
+	};
+
+	class Info {
+	public:
+		Selection selection = Selection::single;
+		// Queues under Selection::host.
+		std::size_t host_queues = 2;
+		// Width and height of the tiles whole frames are split into.
+		std::uint32_t tile_size = 32;
+	};
+
+	DeviceSplit(const Info& info, std::size_t device_count) :
+		tile_size{ std::max<std::uint32_t>(info.tile_size, 1) }, throughputs(std::max<std::size_t>(device_count, 1), 0) {}
+
+	/// @brief The devices to draw on, or none for the GPU selector's.
+	static std::vector<sycl::device> get_devices(const Info& info) {
+		std::vector<sycl::device> devices;
+		if (info.selection == Selection::all) {
+			devices = sycl::device::get_devices();
+		} else if (info.selection == Selection::host) {
+			devices.assign(std::max<std::size_t>(info.host_queues, 1), sycl::device{ sycl::cpu_selector_v });
+		}
+		return devices;
+	}
+
+	/// @brief The tiles each device draws this frame: runs of neighboring tiles, with pixels in proportion to the device's throughput.
+	/// @param tiles The tiles to draw; every pixel of a width x height frame if empty.
+	std::vector<std::vector<Tile>> split(std::size_t width, std::size_t height, const std::vector<Tile>& tiles) const {
+		std::vector<Tile> frame_tiles = tiles;
+		if (frame_tiles.empty()) {
+			for (std::uint32_t y = 0; y < height; y += this->tile_size) {
+				for (std::uint32_t x = 0; x < width; x += this->tile_size) {
+					frame_tiles.push_back({ x, y, std::min<std::uint32_t>(this->tile_size, static_cast<std::uint32_t>(width) - x), std::min<std::uint32_t>(this->tile_size, static_cast<std::uint32_t>(height) - y) });
+				}
+			}
+		}
+		std::vector<Real> throughputs = this->get_throughputs();
+		Real total_throughput = 0;
+		for (Real throughput : throughputs) {
+			total_throughput += throughput;
+		}
+		std::size_t pixel_count = DeviceSplit::get_pixel_count(frame_tiles);
+		// A tile goes to the device whose share of the frame's pixels its middle falls in.
+		std::vector<std::vector<Tile>> shares(throughputs.size());
+		std::size_t device = 0;
+		Real share_end = pixel_count * throughputs[0] / total_throughput;
+		Real pixels_before = 0;
+		for (const Tile& tile : frame_tiles) {
+			Real tile_pixels = static_cast<Real>(tile.width) * tile.height;
+			while (device + 1 < shares.size() && pixels_before + tile_pixels / 2 > share_end) {
+				++device;
+				share_end += pixel_count * throughputs[device] / total_throughput;
+			}
+			shares[device].push_back(tile);
+			pixels_before += tile_pixels;
+		}
+		return shares;
+	}
+
+	/// @brief Records how long a device took to draw its share, for the next frames' shares.
+	void record(std::size_t device, const std::vector<Tile>& tiles, Real seconds) {
+		if (tiles.empty() || seconds <= 0) { return; }
+		Real throughput = DeviceSplit::get_pixel_count(tiles) / seconds;
+		// Smooth it a little, so one slow frame doesn't swing the split back and forth.
+		Real& smoothed = this->throughputs[device];
+		smoothed = smoothed == 0 ? throughput : 0.5_r * smoothed + 0.5_r * throughput;
+	}
+
+	/// @brief The share of the frame each device gets, out of 1.
+	std::vector<Real> get_shares() const {
+		std::vector<Real> shares = this->get_throughputs();
+		Real total = 0;
+		for (Real share : shares) {
+			total += share;
+		}
+		for (Real& share : shares) {
+			share /= total;
+		}
+		return shares;
+	}
+
+private:
+	/// @brief Pixels per second of each device, taking those not measured yet to be as fast as the average of the others.
+	std::vector<Real> get_throughputs() const {
+		Real sum = 0;
+		std::size_t measured = 0;
+		for (Real throughput : this->throughputs) {
+			if (throughput > 0) {
+				sum += throughput;
+				++measured;
+			}
+		}
+		std::vector<Real> throughputs = this->throughputs;
+		for (Real& throughput : throughputs) {
+			if (throughput == 0) {
+				throughput = measured == 0 ? 1 : sum / measured;
+			}
+		}
+		return throughputs;
+	}
+
+	static std::size_t get_pixel_count(const std::vector<Tile>& tiles) {
+		std::size_t pixel_count = 0;
+		for (const Tile& tile : tiles) {
+			pixel_count += static_cast<std::size_t>(tile.width) * tile.height;
+		}
+		return pixel_count;
+	}
+
+	std::uint32_t tile_size;
+	// Smoothed pixels per second each device drew, or 0 before it has drawn any.
+	std::vector<Real> throughputs;
+};
+
+#endif
\ No newline at end of file
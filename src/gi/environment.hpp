@@ -0,0 +1,267 @@
+#ifndef GI_BAH8454_ENVIRONMENT
+#define GI_BAH8454_ENVIRONMENT
+
+// Include SYCL.
+#include <sycl/sycl.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <numbers>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "util.hpp"
+#include "sampling.hpp"
+
+/// @brief Raw pointers to an Environment for kernels: the radiance arriving from infinitely far away in every direction.
+/// Directions are in camera coordinates; the map is laid out over world directions, y up.
+class EnvironmentData {
+public:
+	// Radiance of each texel of the equirectangular map, row by row from the top, or nullptr for a constant background.
+	const Vector3* radiance;
+	std::uint32_t width;
+	std::uint32_t height;
+	// Piecewise-constant distribution proportional to luminance times the solid angle of each texel: the CDF over rows (height + 1 entries), then the CDF within each row (width + 1 entries each).
+	const Real* row_cdf;
+	const Real* column_cdfs;
+	Vector3 background;
+	// Whether any light arrives from the environment at all.
+	bool emitting;
+	Matrix3 to_world;
+	Matrix3 to_camera;
+
+	Vector3 get_radiance(const Vector3& direction) const {
+		if (this->radiance == nullptr) {
+			return this->background;
+		}
+		auto [x, y] = this->get_texel(this->get_uv(direction));
+		return this->radiance[static_cast<std::size_t>(y) * this->width + x];
+	}
+
+	/// @brief Draws a direction in proportion to the radiance arriving from it (uniformly over the sphere for a constant background).
+	/// @return The direction and its solid angle density.
+	Optional<Tuple<Vector3, Real>> sample(const Vector2& u) const {
+		if (this->radiance == nullptr) {
+			return { { sampling::sample_uniform_sphere(u), 1 / (4 * std::numbers::pi_v<Real>) } };
+		}
+		// Pick a row from the marginal distribution, then a column within it (Pharr, Jakob and Humphreys 2016, 13.6.7).
+		// Inverting the CDFs rather than an alias table keeps neighbouring random numbers on neighbouring texels.
+		auto [y, dv] = EnvironmentData::invert(this->row_cdf, this->height, u[1]);
+		auto [x, du] = EnvironmentData::invert(this->column_cdfs + static_cast<std::size_t>(y) * (this->width + 1), this->width, u[0]);
+		Real pdf = this->get_texel_pdf(x, y);
+		if (pdf <= 0) { return {}; }
+		Vector2 uv{ (x + du) / this->width, (y + dv) / this->height };
+		Real theta = std::numbers::pi_v<Real> * uv[1];
+		Real sin_theta = std::sin(theta);
+		if (sin_theta <= 0) { return {}; }
+		Real phi = 2 * std::numbers::pi_v<Real> * (uv[0] - 0.5_r);
+		Vector3 direction = this->to_camera * Vector3{ sin_theta * std::sin(phi), std::cos(theta), -sin_theta * std::cos(phi) };
+		return { { direction.normalized(), pdf / (2 * std::numbers::pi_v<Real> * std::numbers::pi_v<Real> * sin_theta) } };
+	}
+
+	/// @brief Solid angle density of sample returning direction.
+	Real get_pdf(const Vector3& direction) const {
+		if (this->radiance == nullptr) {
+			return 1 / (4 * std::numbers::pi_v<Real>);
+		}
+		Vector2 uv = this->get_uv(direction);
+		Real sin_theta = std::sin(std::numbers::pi_v<Real> * uv[1]);
+		if (sin_theta <= 0) { return 0; }
+		auto [x, y] = this->get_texel(uv);
+		return this->get_texel_pdf(x, y) / (2 * std::numbers::pi_v<Real> * std::numbers::pi_v<Real> * sin_theta);
+	}
+
+private:
+	/// @brief Equirectangular coordinates of a direction: longitude across, from the world's -z axis, and polar angle down, from +y.
+	Vector2 get_uv(const Vector3& direction) const {
+		Vector3 d = (this->to_world * direction).normalized();
+		return {
+			0.5_r + std::atan2(d.x(), -d.z()) / (2 * std::numbers::pi_v<Real>),
+			std::acos(std::clamp(d.y(), -1_r, 1_r)) / std::numbers::pi_v<Real>
+		};
+	}
+
+	Tuple<std::uint32_t, std::uint32_t> get_texel(const Vector2& uv) const {
+		return {
+			std::min(static_cast<std::uint32_t>(std::max(uv[0], 0_r) * this->width), this->width - 1),
+			std::min(static_cast<std::uint32_t>(std::max(uv[1], 0_r) * this->height), this->height - 1)
+		};
+	}
+
+	/// @brief Density of (u, v) over the unit square within a texel.
+	Real get_texel_pdf(std::uint32_t x, std::uint32_t y) const {
+		const Real* column_cdf = this->column_cdfs + static_cast<std::size_t>(y) * (this->width + 1);
+		return (this->row_cdf[y + 1] - this->row_cdf[y]) * this->height * (column_cdf[x + 1] - column_cdf[x]) * this->width;
+	}
+
+	/// @brief The bin of a CDF over count bins that u falls in, and how far into the bin it falls.
+	static Tuple<std::uint32_t, Real> invert(const Real* cdf, std::uint32_t count, Real u) {
+		// Find the last entry no greater than u by binary search.
+		std::uint32_t first = 0;
+		std::uint32_t last = count;
+		while (last - first > 1) {
+			std::uint32_t middle = (first + last) / 2;
+			if (cdf[middle] <= u) {
+				first = middle;
+			} else {
+				last = middle;
+			}
+		}
+		Real width = cdf[first + 1] - cdf[first];
+		return { first, width > 0 ? std::clamp((u - cdf[first]) / width, 0_r, 1_r) : 0_r };
+	}
+};
+
+/// @brief The environment: a constant background color or an HDR equirectangular map, seen by rays that escape the scene and lighting it like any other light.
+class Environment {
+public:
+	Environment(sycl::queue& q, const Vector3& background) :
+		radiance{ SharedAllocator<Vector3>{ q } },
+		row_cdf{ SharedAllocator<Real>{ q } },
+		column_cdfs{ SharedAllocator<Real>{ q } },
+		background{ background },
+		data{ 1, EnvironmentData{}, SharedAllocator<EnvironmentData>{ q } }
+	{}
+
+	/// @brief Loads an equirectangular Radiance RGBE (.hdr) image, flat or with run-length encoded scanlines, and builds its sampling distribution.
+	/// @param intensity Scale applied to the radiance of every texel.
+	void load_hdr(const std::string& path, Real intensity = 1) {
+		std::ifstream file{ path, std::ios::binary };
+		std::string line;
+		std::getline(file, line);
+		if (!file || !line.starts_with("#?")) {
+			throw std::runtime_error{ "Could not read \"" + path + "\" as a Radiance HDR image." };
+		}
+		// The header ends with an empty line.
+		while (std::getline(file, line) && !line.empty()) {
+			if (line.starts_with("FORMAT=") && line != "FORMAT=32-bit_rle_rgbe") {
+				throw std::runtime_error{ "The Radiance HDR image \"" + path + "\" is not in RGBE format." };
+			}
+		}
+		std::getline(file, line);
+		std::istringstream resolution{ line };
+		std::string y_axis, x_axis;
+		std::uint32_t width = 0, height = 0;
+		resolution >> y_axis >> height >> x_axis >> width;
+		if (!file || !resolution || y_axis != "-Y" || x_axis != "+X" || width == 0 || height == 0) {
+			throw std::runtime_error{ "The Radiance HDR image \"" + path + "\" has an unsupported orientation or size." };
+		}
+		std::vector<Vector3> texels(static_cast<std::size_t>(width) * height);
+		std::vector<std::uint8_t> scanline(static_cast<std::size_t>(width) * 4);
+		for (std::uint32_t y = 0; y < height; ++y) {
+			if (!Environment::read_scanline(file, width, scanline)) {
+				throw std::runtime_error{ "The Radiance HDR image \"" + path + "\" is truncated." };
+			}
+			for (std::uint32_t x = 0; x < width; ++x) {
+				const std::uint8_t* rgbe = &scanline[4 * x];
+				Real scale = rgbe[3] == 0 ? 0 : intensity * std::ldexp(1_r, rgbe[3] - (128 + 8));
+				texels[static_cast<std::size_t>(y) * width + x] = Vector3{ rgbe[0] + 0.5_r, rgbe[1] + 0.5_r, rgbe[2] + 0.5_r } * scale;
+			}
+		}
+		this->set_map(width, height, texels);
+	}
+
+	/// @brief Uses radiance, width * height texels row by row from the top, as the environment map.
+	void set_map(std::uint32_t width, std::uint32_t height, const std::vector<Vector3>& radiance) {
+		this->width = width;
+		this->height = height;
+		this->radiance.assign(radiance.begin(), radiance.end());
+		// Weight every texel by the solid angle it covers, which shrinks towards the poles.
+		this->row_cdf.assign(height + 1, 0);
+		this->column_cdfs.assign(static_cast<std::size_t>(height) * (width + 1), 0);
+		for (std::uint32_t y = 0; y < height; ++y) {
+			Real sin_theta = std::sin(std::numbers::pi_v<Real> * (y + 0.5_r) / height);
+			Real* column_cdf = &this->column_cdfs[static_cast<std::size_t>(y) * (width + 1)];
+			for (std::uint32_t x = 0; x < width; ++x) {
+				column_cdf[x + 1] = column_cdf[x] + absolute_illuminance(radiance[static_cast<std::size_t>(y) * width + x]) * sin_theta;
+			}
+			Real row_sum = column_cdf[width];
+			for (std::uint32_t x = 1; x <= width; ++x) {
+				// Rows without light are never picked; keep their CDF valid anyway.
+				column_cdf[x] = row_sum > 0 ? column_cdf[x] / row_sum : static_cast<Real>(x) / width;
+			}
+			this->row_cdf[y + 1] = this->row_cdf[y] + row_sum;
+		}
+		Real total = this->row_cdf[height];
+		if (total <= 0) {
+			// A black map lights nothing; drop it so nothing samples it.
+			this->radiance.clear();
+			return;
+		}
+		for (std::uint32_t y = 1; y <= height; ++y) {
+			this->row_cdf[y] /= total;
+		}
+	}
+
+	/// @brief Follows the camera: environment directions are looked up in world coordinates.
+	void obtain_camera_coordinates(const Matrix3H& view) {
+		this->to_camera = view.topLeftCorner<3, 3>();
+		this->to_world = this->to_camera.inverse();
+	}
+
+	bool has_map() const {
+		return !this->radiance.empty();
+	}
+
+	EnvironmentData* get_data() {
+		this->data[0] = {
+			.radiance = this->has_map() ? this->radiance.data() : nullptr,
+			.width = this->width,
+			.height = this->height,
+			.row_cdf = this->row_cdf.data(),
+			.column_cdfs = this->column_cdfs.data(),
+			.background = this->background,
+			.emitting = this->has_map() || !this->background.isZero(),
+			.to_world = this->to_world,
+			.to_camera = this->to_camera
+		};
+		return this->data.data();
+	}
+
+	Shared<Vector3, SharedAllocator<Vector3>> radiance;
+	Shared<Real, SharedAllocator<Real>> row_cdf;
+	Shared<Real, SharedAllocator<Real>> column_cdfs;
+	std::uint32_t width = 0;
+	std::uint32_t height = 0;
+
+	// Radiance from every direction while no map is loaded.
+	Vector3 background;
+
+private:
+	Shared<EnvironmentData, SharedAllocator<EnvironmentData>> data;
+	Matrix3 to_world = Matrix3::Identity();
+	Matrix3 to_camera = Matrix3::Identity();
+
+	/// @brief Reads one scanline of RGBE texels.
+	static bool read_scanline(std::istream& file, std::uint32_t width, std::vector<std::uint8_t>& scanline) {
+		std::uint8_t start[4];
+		if (!file.read(reinterpret_cast<char*>(start), 4)) { return false; }
+		bool run_length_encoded = width >= 8 && width < 0x8000 && start[0] == 2 && start[1] == 2 && !(start[2] & 0x80);
+		if (!run_length_encoded) {
+			std::copy_n(start, 4, scanline.begin());
+			return static_cast<bool>(file.read(reinterpret_cast<char*>(scanline.data() + 4), (static_cast<std::size_t>(width) - 1) * 4));
+		}
+		if ((static_cast<std::uint32_t>(start[2]) << 8 | start[3]) != width) { return false; }
+		// Each channel of the scanline is encoded separately, as runs of one byte and literal spans.
+		for (std::uint32_t channel = 0; channel < 4; ++channel) {
+			for (std::uint32_t x = 0; x < width;) {
+				int count = file.get();
+				if (count == std::char_traits<char>::eof()) { return false; }
+				bool run = count > 128;
+				if (run) { count -= 128; }
+				if (count == 0 || x + count > width) { return false; }
+				int value = run ? file.get() : 0;
+				for (int i = 0; i < count; ++i, ++x) {
+					scanline[4 * x + channel] = static_cast<std::uint8_t>(run ? value : file.get());
+				}
+			}
+		}
+		return static_cast<bool>(file);
+	}
+};
+
+#endif
\ No newline at end of file
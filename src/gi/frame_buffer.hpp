@@ -9,6 +9,9 @@
 #include <bit>
 #include <span>
 #include <algorithm>
+#include <array>
+#include <string>
+#include <string_view>
 
 #include "util.hpp"
 
@@ -31,10 +34,11 @@ public:
 		std::size_t height;
 	};
 
-	FrameBuffer(sycl::queue& q, Info info) : q{ q }, width{ info.width }, height{ info.height } {
+	FrameBuffer(sycl::queue& q, Info info) : width{ info.width }, height{ info.height }, output_width{ info.width }, output_height{ info.height }, q{ q } {
 		this->pixels = sycl::malloc_shared<Vector3>(sizeof(Vector3) * this->width * this->height, q);
 		this->illuminances = sycl::malloc_shared<Real>(sizeof(Real) * this->width * this->height, q);
 		this->rgba_pixels = sycl::malloc_shared<Pixel>(sizeof(Pixel) * this->width * this->height, q);
+		this->output_pixels = sycl::malloc_shared<Pixel>(sizeof(Pixel) * this->width * this->height, q);
 	}
 
 	FrameBuffer(const FrameBuffer&) = delete;
@@ -43,6 +47,44 @@ public:
 		sycl::free(this->pixels, this->q);
 		sycl::free(this->illuminances, this->q);
 		sycl::free(this->rgba_pixels, this->q);
+		sycl::free(this->output_pixels, this->q);
+	}
+
+	/// @brief Changes the size frames are rendered and tone mapped at, at most the size of the output; upscale stretches them to the output.
+	void resize(std::size_t width, std::size_t height) {
+		this->width = std::clamp<std::size_t>(width, 1, this->output_width);
+		this->height = std::clamp<std::size_t>(height, 1, this->output_height);
+	}
+
+	/// @brief Stretches the tone mapped frame over the output with bilinear filtering, if it was rendered smaller.
+	void upscale() {
+		this->upscaled = this->width != this->output_width || this->height != this->output_height;
+		if (!this->upscaled) {
+			return;
+		}
+		this->q.parallel_for(
+			{ this->output_width * this->output_height },
+			[
+				source = this->rgba_pixels, target = this->output_pixels,
+				width = this->width, height = this->height, output_width = this->output_width, output_height = this->output_height
+			](std::size_t i) {
+				// Sample the source at the output pixel's center.
+				Real x = std::clamp(((i % output_width) + 0.5_r) * width / output_width - 0.5_r, 0_r, static_cast<Real>(width - 1));
+				Real y = std::clamp(((i / output_width) + 0.5_r) * height / output_height - 0.5_r, 0_r, static_cast<Real>(height - 1));
+				std::size_t x0 = static_cast<std::size_t>(x);
+				std::size_t y0 = static_cast<std::size_t>(y);
+				std::size_t x1 = std::min(x0 + 1, width - 1);
+				std::size_t y1 = std::min(y0 + 1, height - 1);
+				Real fx = x - x0;
+				Real fy = y - y0;
+				auto blend = [&](auto channel) {
+					Real top = (1 - fx) * (source[y0 * width + x0].*channel) + fx * (source[y0 * width + x1].*channel);
+					Real bottom = (1 - fx) * (source[y1 * width + x0].*channel) + fx * (source[y1 * width + x1].*channel);
+					return static_cast<std::uint8_t>((1 - fy) * top + fy * bottom + 0.5_r);
+				};
+				target[i] = { blend(&Pixel::r), blend(&Pixel::g), blend(&Pixel::b) };
+			}
+		).wait();
 	}
 
 	void tone_reproduction_none() {
@@ -126,18 +168,104 @@ public:
 		return this->pixels[i];
 	}
 
+	/// @brief The tone mapped frame at the output size.
 	std::span<const std::byte> get_bytes() {
-		return { std::bit_cast<std::byte*>(this->rgba_pixels), width * height * sizeof(Pixel) };
+		// The render size may have changed since the frame was upscaled.
+		Pixel* output = this->upscaled ? this->output_pixels : this->rgba_pixels;
+		return { std::bit_cast<std::byte*>(output), output_width * output_height * sizeof(Pixel) };
+	}
+
+	/// @brief The tone mapped frame at the output size as a PNG file.
+	/// The pixels are stored without compression (in deflate's stored blocks), which costs size but no time: frames are rendered much slower than they would compress.
+	std::string encode_png() {
+		std::span<const std::byte> bytes = this->get_bytes();
+		std::size_t row_size = this->output_width * sizeof(Pixel);
+		// Every row starts with its filter type, 0 for none.
+		std::string scanlines;
+		scanlines.reserve(this->output_height * (row_size + 1));
+		for (std::size_t y = 0; y < this->output_height; ++y) {
+			scanlines.push_back(0);
+			scanlines.append(reinterpret_cast<const char*>(bytes.data() + y * row_size), row_size);
+		}
+		// Wrap the scanlines in a zlib stream of stored blocks of at most 65535 bytes.
+		std::string zlib{ '\x78', '\x01' };
+		for (std::size_t offset = 0; offset < scanlines.size() || offset == 0; offset += 65535) {
+			std::size_t size = std::min<std::size_t>(scanlines.size() - offset, 65535);
+			zlib.push_back(offset + size == scanlines.size() ? 1 : 0);
+			FrameBuffer::append_le16(zlib, static_cast<std::uint16_t>(size));
+			FrameBuffer::append_le16(zlib, static_cast<std::uint16_t>(~size));
+			zlib.append(scanlines, offset, size);
+		}
+		std::uint32_t a = 1;
+		std::uint32_t b = 0;
+		for (char c : scanlines) {
+			a = (a + static_cast<std::uint8_t>(c)) % 65521;
+			b = (b + a) % 65521;
+		}
+		FrameBuffer::append_be32(zlib, (b << 16) | a);
+
+		std::string png{ "\x89PNG\r\n\x1a\n", 8 };
+		std::string header;
+		FrameBuffer::append_be32(header, static_cast<std::uint32_t>(this->output_width));
+		FrameBuffer::append_be32(header, static_cast<std::uint32_t>(this->output_height));
+		// 8 bits per channel, RGBA, deflate, no filtering beyond per-row types, no interlacing.
+		header.append({ 8, 6, 0, 0, 0 });
+		FrameBuffer::append_png_chunk(png, "IHDR", header);
+		FrameBuffer::append_png_chunk(png, "IDAT", zlib);
+		FrameBuffer::append_png_chunk(png, "IEND", {});
+		return png;
 	}
 
+	// Size frames are rendered at.
 	std::size_t width;
 	std::size_t height;
+	// Size of the frames handed out, which buffers are allocated for.
+	std::size_t output_width;
+	std::size_t output_height;
+	// Whether the last frame was rendered smaller than the output and stretched over it.
+	bool upscaled = false;
 
 	sycl::queue& q;
 	Vector3* pixels;
 	Real* illuminances;
 	Pixel* rgba_pixels;
+	Pixel* output_pixels;
 
+private:
+	static void append_le16(std::string& bytes, std::uint16_t value) {
+		bytes.push_back(static_cast<char>(value & 0xff));
+		bytes.push_back(static_cast<char>(value >> 8));
+	}
+
+	static void append_be32(std::string& bytes, std::uint32_t value) {
+		for (int shift = 24; shift >= 0; shift -= 8) {
+			bytes.push_back(static_cast<char>((value >> shift) & 0xff));
+		}
+	}
+
+	/// @brief Appends a chunk: its length, type, data and the CRC-32 of the type and data.
+	static void append_png_chunk(std::string& png, std::string_view type, std::string_view data) {
+		static const std::array<std::uint32_t, 256> crc_table = []() {
+			std::array<std::uint32_t, 256> table;
+			for (std::uint32_t n = 0; n < 256; ++n) {
+				std::uint32_t c = n;
+				for (int k = 0; k < 8; ++k) {
+					c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+				}
+				table[n] = c;
+			}
+			return table;
+		}();
+		FrameBuffer::append_be32(png, static_cast<std::uint32_t>(data.size()));
+		std::size_t start = png.size();
+		png.append(type);
+		png.append(data);
+		std::uint32_t crc = 0xffffffffu;
+		for (std::size_t i = start; i < png.size(); ++i) {
+			crc = crc_table[(crc ^ static_cast<std::uint8_t>(png[i])) & 0xff] ^ (crc >> 8);
+		}
+		FrameBuffer::append_be32(png, crc ^ 0xffffffffu);
+	}
 };
 
 #endif
\ No newline at end of file
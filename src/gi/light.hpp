@@ -1,18 +1,164 @@
 #ifndef GI_BAH8454_LIGHT
 #define GI_BAH8454_LIGHT
 
+#include <cstdint>
+#include <limits>
+#include <numbers>
+
 #include "util.hpp"
+#include "ray.hpp"
+#include "sampling.hpp"
+
+/// @brief How direct light from area lights is estimated.
+enum class LightSampling : std::uint32_t {
+	// Shadow rays towards points sampled on the lights.
+	light,
+	// Rays sampled from the BRDF that happen to hit a light.
+	bsdf,
+	// Both, weighted with the power heuristic (Veach and Guibas 1995).
+	multiple_importance,
+	// Rays uniform over the hemisphere that happen to hit a light, as a baseline for the others.
+	uniform
+};
 
+/// @brief A point light, or an emitter with area (a parallelogram, a sphere, or a triangle of a mesh) that casts soft shadows.
+/// Parallelograms and triangles emit from the side their edges wind counter-clockwise around; spheres emit everywhere.
 class Light {
 public:
+	enum class Shape : std::uint32_t {
+		point,
+		rectangle,
+		sphere,
+		triangle
+	};
+
+	/// @brief A point on a light seen from a shading point.
+	class Sample {
+	public:
+		// Unit direction from the shading point.
+		Vector3 direction;
+		Real distance;
+		// Solid angle density of the direction.
+		Real pdf;
+	};
+
 	Light(const Vector3H& world_position, const Vector3& color = { 1.1, 1.1, 1.1 }) : world_position{ world_position }, color{ color } {}
 
+	/// @param color Emitted radiance.
+	static Light rectangle(const Vector3H& corner, const Vector3& edge0, const Vector3& edge1, const Vector3& color) {
+		Light light{ corner, color };
+		light.shape = Shape::rectangle;
+		light.world_edges = { Vector3H{ edge0.x(), edge0.y(), edge0.z(), 0 }, Vector3H{ edge1.x(), edge1.y(), edge1.z(), 0 } };
+		return light;
+	}
+
+	static Light sphere(const Vector3H& center, Real radius, const Vector3& color) {
+		Light light{ center, color };
+		light.shape = Shape::sphere;
+		light.radius = radius;
+		return light;
+	}
+
+	static Light triangle(const Vector3H& v0, const Vector3H& v1, const Vector3H& v2, const Vector3& color) {
+		Light light{ v0, color };
+		light.shape = Shape::triangle;
+		light.world_edges = { v1 / v1.w() - v0 / v0.w(), v2 / v2.w() - v0 / v0.w() };
+		return light;
+	}
+
 	void obtain_camera_coordinates(const Matrix3H& view) {
 		this->camera_position = from_homogeneous(view * this->world_position);
+		this->camera_edges = { (view * this->world_edges[0]).head<3>(), (view * this->world_edges[1]).head<3>() };
+	}
+
+	bool has_area() const {
+		return this->shape != Shape::point;
+	}
+
+	/// @brief Samples a direction towards the light from a shading point, uniformly over its area (or over the cone it subtends, for spheres).
+	Optional<Sample> sample(const Vector3& reference, const Vector2& u) const {
+		if (this->shape == Shape::sphere) {
+			Vector3 to_center = this->camera_position - reference;
+			Real distance_squared = to_center.squaredNorm();
+			if (distance_squared <= this->radius * this->radius) { return {}; }
+			Real cos_theta_max = std::sqrt(1 - this->radius * this->radius / distance_squared);
+			Vector3 direction = sampling::get_direction_around(to_center.normalized(), 1 - u[0] * (1 - cos_theta_max), u[1]);
+			Optional<Real> distance = this->intersects(Ray{ reference, direction });
+			if (!distance) { return {}; }
+			return { { direction, *distance, 1 / (2 * std::numbers::pi_v<Real> * (1 - cos_theta_max)) } };
+		}
+		if (this->shape == Shape::point) { return {}; }
+		Vector2 uv = u;
+		if (this->shape == Shape::triangle) {
+			// Fold the square onto the triangle uniformly.
+			Real root = std::sqrt(u[0]);
+			uv = { root * (1 - u[1]), root * u[1] };
+		}
+		Vector3 position = this->camera_position + uv[0] * this->camera_edges[0] + uv[1] * this->camera_edges[1];
+		Vector3 offset = position - reference;
+		Real distance = offset.norm();
+		if (distance <= 0) { return {}; }
+		Vector3 direction = offset / distance;
+		Real pdf = this->get_pdf(reference, direction, distance);
+		if (pdf <= 0) { return {}; }
+		return { { direction, distance, pdf } };
+	}
+
+	/// @brief Solid angle density of sample choosing direction, which reaches the light after distance.
+	Real get_pdf(const Vector3& reference, const Vector3& direction, Real distance) const {
+		if (this->shape == Shape::sphere) {
+			Real distance_squared = (this->camera_position - reference).squaredNorm();
+			if (distance_squared <= this->radius * this->radius) { return 0; }
+			Real cos_theta_max = std::sqrt(1 - this->radius * this->radius / distance_squared);
+			return 1 / (2 * std::numbers::pi_v<Real> * (1 - cos_theta_max));
+		}
+		if (this->shape == Shape::point) { return 0; }
+		Vector3 normal = this->camera_edges[0].cross(this->camera_edges[1]);
+		Real area = normal.norm() * (this->shape == Shape::triangle ? 0.5_r : 1);
+		Real cosine = -normal.normalized().dot(direction);
+		if (cosine <= 0 || area <= 0) { return 0; }
+		return distance * distance / (cosine * area);
+	}
+
+	/// @brief Distance along a ray to the emitting side of the light, if it hits it.
+	Optional<Real> intersects(const Ray& ray) const {
+		if (this->shape == Shape::sphere) {
+			Vector3 offset = ray.origin - this->camera_position;
+			Real b = offset.dot(ray.direction);
+			Real c = offset.squaredNorm() - this->radius * this->radius;
+			Real discriminant = b * b - c;
+			if (discriminant < 0) { return {}; }
+			Real root = std::sqrt(discriminant);
+			Real distance = -b - root > 0 ? -b - root : -b + root;
+			if (distance <= 0) { return {}; }
+			return distance;
+		}
+		if (this->shape == Shape::point) { return {}; }
+		// Solve origin + t * direction = position + a * edge0 + b * edge1 (Möller and Trumbore 1997).
+		const Vector3& edge0 = this->camera_edges[0];
+		const Vector3& edge1 = this->camera_edges[1];
+		if (edge0.cross(edge1).dot(ray.direction) >= 0) { return {}; }
+		Vector3 p = ray.direction.cross(edge1);
+		Real determinant = edge0.dot(p);
+		Vector3 s = ray.origin - this->camera_position;
+		Real a = s.dot(p) / determinant;
+		Vector3 q = s.cross(edge0);
+		Real b = ray.direction.dot(q) / determinant;
+		Real distance = edge1.dot(q) / determinant;
+		bool inside = this->shape == Shape::triangle ? (a >= 0 && b >= 0 && a + b <= 1) : (a >= 0 && a <= 1 && b >= 0 && b <= 1);
+		if (!inside || distance <= 0) { return {}; }
+		return distance;
 	}
 
+	Shape shape = Shape::point;
+	// Position of point lights, center of spheres, a corner of parallelograms and triangles.
 	Vector3H world_position;
 	Vector3 camera_position;
+	// Edges of parallelograms and triangles from the corner.
+	Array<Vector3H, 2> world_edges{ Vector3H{ 0, 0, 0, 0 }, Vector3H{ 0, 0, 0, 0 } };
+	Array<Vector3, 2> camera_edges{ Vector3{ 0, 0, 0 }, Vector3{ 0, 0, 0 } };
+	Real radius = 0;
+	// Intensity of point lights, radiance of lights with area.
 	Vector3 color;
 };
 
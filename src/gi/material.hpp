@@ -1,46 +1,64 @@
 #ifndef GI_BAH8454_MATERIAL
 #define GI_BAH8454_MATERIAL
 
+#include <cstdint>
+#include <numbers>
+
 #include "util.hpp"
+#include "texture.hpp"
+#include "sampling.hpp"
 
 class MaterialInfo {
 public:
 	Vector3 position;
 	Vector3 normal;
+	// Barycentric weights of the hit (triangles only).
+	Vector3 barycentric;
+	// Texture coordinates of the hit (objects with UVs only).
+	Vector2 uv;
+	// Width of the pixel's footprint on the surface in UV units (0 without UVs), selecting texture mip levels.
+	Real uv_footprint;
+	// Textures the material can sample.
+	const TextureData* textures;
 	Vector3 light_position;
 	Vector3 light_color;
 };
 
-template <typename ObjectType>
+/// @brief Shading parameters.  Materials live in a table in shared memory and objects refer to them by index, so many objects share one and it can be edited without touching geometry.
 class Material {
 public:
-	// static Vector3 default_shadow_shader(const ObjectType& object, const MaterialInfo& info) { return Vector3{ 0, 0, 0 }; } // TODO: Default shadow shader.
-
-	//using ShaderType = std::function<Vector3(const ObjectType&, const MaterialInfo&)>;
-	//using ShaderType = Vector3(*)(const ObjectType&, const MaterialInfo&);
-
-	Material() {}
-
-	Material(
-		Real reflection_constant,
-		Real transmission_constant,
-		Real medium_index
-		//const ShaderType shader,
-		//const ShaderType shadow_shader
-	) :
-		reflection_constant{ reflection_constant },
-		transmission_constant{ transmission_constant },
-		medium_index{ medium_index }
-		//shader{ shader },
-		//shadow_shader{ shadow_shader }
-	{}
+	// Index of the shader in the renderer's ShaderRegistry (0 is the first shader registered).
+	std::uint32_t shader = 0;
+
+	// Where the diffuse color comes from.
+	enum class Albedo : std::uint32_t {
+		constant,
+		// The normal mapped to [0, 1], for debugging geometry.
+		normal,
+		// Checks of albedo and checker_albedo over the object's UV coordinates.
+		checkerboard,
+		// The albedo texture over the object's UV coordinates, tinted by albedo.
+		texture
+	};
+
+	Albedo albedo_source = Albedo::constant;
+	Vector3 albedo{ 1, 1, 1 };
+	Vector3 checker_albedo{ 0, 0, 0 };
+	// Number of checks per unit of UV.
+	Vector2 checker_count{ 1, 1 };
+	// Index into the renderer's texture store.
+	std::uint32_t albedo_texture = 0;
+
+	// Phong terms.
+	Vector3 specular_color{ 1, 1, 1 };
+	Real ambient_constant = 0.2;
+	Real diffuse_constant = 0.4;
+	Real specular_constant = 0.4;
+	Real shininess = 10;
 
 	Real reflection_constant = 0;
 	Real transmission_constant = 0;
 	Real medium_index = 1;
-
-	//ShaderType shader;
-	//ShaderType shadow_shader;
 };
 
 namespace shader {
@@ -76,6 +94,103 @@ inline Vector3 phong_shadow(const MaterialInfo& info, const Vector3& color, Real
 	return (ambient_constant * color.cwiseProduct(info.light_color)).eval();
 }
 
+/// @brief The diffuse color of a material at a hit.
+inline Vector3 get_albedo(const MaterialInfo& info, const Material& material) {
+	if (material.albedo_source == Material::Albedo::normal) {
+		return (info.normal + Vector3{ 1, 1, 1 }) / 2;
+	}
+	if (material.albedo_source == Material::Albedo::checkerboard) {
+		Vector2 uv = info.uv.cwiseProduct(material.checker_count);
+		if (static_cast<std::size_t>(uv[0]) % 2 != static_cast<std::size_t>(uv[1]) % 2) {
+			return material.checker_albedo;
+		}
+	}
+	if (material.albedo_source == Material::Albedo::texture) {
+		return material.albedo.cwiseProduct(info.textures->sample(material.albedo_texture, info.uv, info.uv_footprint));
+	}
+	return material.albedo;
+}
+
+/// @brief Phong shading with the terms of a material.
+inline Vector3 phong(const MaterialInfo& info, const Material& material) {
+	return shader::phong(
+		info, shader::get_albedo(info, material), material.specular_color,
+		material.ambient_constant, material.diffuse_constant, material.specular_constant, material.shininess
+	);
+}
+
+/// @brief A material's Phong terms as an energy-normalized BRDF (Lafortune and Willems 1994), for integrating lights with area.
+/// Like the phong shader it takes the view direction to be the one from the camera.
+class PhongBRDF {
+public:
+	PhongBRDF(const MaterialInfo& info, const Material& material) :
+		normal{ info.normal },
+		reflection{ reflect(info.position.normalized(), info.normal).normalized() },
+		diffuse{ material.diffuse_constant * shader::get_albedo(info, material) },
+		specular{ material.specular_constant * material.specular_color },
+		shininess{ material.shininess },
+		diffuse_probability{ material.diffuse_constant + material.specular_constant > 0 ? material.diffuse_constant / (material.diffuse_constant + material.specular_constant) : 1 }
+	{}
+
+	/// @brief Reflected radiance per unit of irradiance arriving from direction.
+	Vector3 evaluate(const Vector3& direction) const {
+		if (this->normal.dot(direction) <= 0) { return { 0, 0, 0 }; }
+		Real lobe = pow(std::max(this->reflection.dot(direction), 0_r), this->shininess);
+		return this->diffuse / std::numbers::pi_v<Real> + this->specular * ((this->shininess + 2) / (2 * std::numbers::pi_v<Real>) * lobe);
+	}
+
+	/// @brief Solid angle density of sample returning direction.
+	Real get_pdf(const Vector3& direction) const {
+		Real cosine = this->normal.dot(direction);
+		if (cosine <= 0) { return 0; }
+		Real lobe = pow(std::max(this->reflection.dot(direction), 0_r), this->shininess);
+		return this->diffuse_probability * cosine / std::numbers::pi_v<Real>
+			+ (1 - this->diffuse_probability) * (this->shininess + 1) / (2 * std::numbers::pi_v<Real>) * lobe;
+	}
+
+	/// @brief Draws a direction from the diffuse or the specular lobe in proportion to their constants.
+	/// @return The direction and its density, or nothing if it points below the surface.
+	Optional<Tuple<Vector3, Real>> sample(Vector2 u) const {
+		Vector3 direction;
+		if (u[0] < this->diffuse_probability) {
+			u[0] /= this->diffuse_probability;
+			direction = sampling::sample_cosine_hemisphere(this->normal, u);
+		} else {
+			u[0] = (u[0] - this->diffuse_probability) / (1 - this->diffuse_probability);
+			direction = sampling::get_direction_around(this->reflection, pow(u[0], 1 / (this->shininess + 1)), u[1]);
+		}
+		Real pdf = this->get_pdf(direction);
+		if (pdf <= 0) { return {}; }
+		return { { direction, pdf } };
+	}
+
+private:
+	Vector3 normal;
+	// Mirror direction of the view direction.
+	Vector3 reflection;
+	Vector3 diffuse;
+	Vector3 specular;
+	Real shininess;
+	Real diffuse_probability;
+};
+
+// Shader functors for ShaderRegistry.
+
+class Phong {
+public:
+	Vector3 operator()(const MaterialInfo& info, const Material& material) const {
+		return shader::phong(info, material);
+	}
+};
+
+/// @brief The albedo alone, ignoring the light.
+class Unlit {
+public:
+	Vector3 operator()(const MaterialInfo& info, const Material& material) const {
+		return shader::get_albedo(info, material);
+	}
+};
+
 };
 
 #endif
\ No newline at end of file
@@ -11,7 +11,7 @@ template <typename T>
 concept RenderableObject = requires (T object, const Ray& ray, const Matrix3H& view) {
 	//{ object.intersects(ray) } -> std::same_as<Optional<Tuple<Vector3, Vector3>>>;
 	//{ object.obtain_camera_coordinates(view) } -> std::same_as<void>;
-	//{ object.materal } -> std::same_as<Material<T>>;
+	//{ object.material } -> std::same_as<std::uint32_t>;
 	true;
 };
 
@@ -1,23 +1,24 @@
 #ifndef GI_BAH8454_SPHERE
 #define GI_BAH8454_SPHERE
 
+#include <cstdint>
 #include <tuple>
 #include <optional>
 
 #include "../util.hpp"
 #include "../ray.hpp"
 #include "../material.hpp"
+#include "../bvh/aabb.hpp"
 
 class Sphere {
 public:
-	Sphere(const Vector3H& position, Real radius, const Material<Sphere>& material) :
+	Sphere(const Vector3H& position, Real radius, std::uint32_t material = 0) :
 		world_position{ position },
 		radius{ radius },
 		material{ material }
 	{}
 
-	// TODO: We might want to move these vectors with rvalue references.
-	Optional<Tuple<Vector3, Vector3>> intersects(const Ray& ray) const {
+	Optional<Hit> intersects(const Ray& ray) const {
 		// Get a, b, and c to perform the quadratic formula (a is equal to 1 if the ray is normalized so we ignore it).
 		Real b = 2 * (
 			ray.direction.x() * (ray.origin.x() - this->camera_position.x()) +
@@ -37,8 +38,9 @@ public:
 			return {};
 		}
 		// Obtain the result of the quadratic equation.
-		Real root_0 = (-b + std::sqrt(discriminant)) / 2;
-		Real root_1 = (-b - std::sqrt(discriminant)) / 2;
+		Real discriminant_root = std::sqrt(discriminant);
+		Real root_0 = (-b + discriminant_root) / 2;
+		Real root_1 = (-b - discriminant_root) / 2;
 		// Use the least positive root.
 		Real root;
 		if (root_0 < 0) {
@@ -54,31 +56,36 @@ public:
 				root = std::min(root_0, root_1);
 			}
 		}
-		// Get the point and normal.
-		Vector3 point{
-			(ray.origin.x() + ray.direction.x() * root),
-			(ray.origin.y() + ray.direction.y() * root),
-			(ray.origin.z() + ray.direction.z() * root)
-		};
-		Vector3 normal{
-			(point.x() - this->camera_position.x()),
-			(point.y() - this->camera_position.y()),
-			(point.z() - this->camera_position.z())
-		};
-		// Return the point and normal.
-		Vector3 normalized_normal = normal.normalized();
-		return { { point, normalized_normal } };
+		return { { .distance = root } };
+	}
+
+	Vector3 get_normal(const Vector3& position, const Hit&) const {
+		return (position - this->camera_position) / this->radius;
 	}
 
 	void obtain_camera_coordinates(const Matrix3H& view) {
 		this->camera_position = from_homogeneous(view * this->world_position);
 	}
 
+	AABB get_bounds() const {
+		Vector3 radius{ this->radius, this->radius, this->radius };
+		return { this->camera_position - radius, this->camera_position + radius };
+	}
+
+	/// @brief Bounds of the part of the sphere between two planes perpendicular to axis (conservatively the clipped bounding box).
+	AABB get_clipped_bounds(int axis, Real minimum, Real maximum) const {
+		AABB bounds = this->get_bounds();
+		bounds.minimum[axis] = std::max(bounds.minimum[axis], minimum);
+		bounds.maximum[axis] = std::min(bounds.maximum[axis], maximum);
+		return bounds;
+	}
+
 	Vector3H world_position;
 	Vector3 camera_position;
 	Real radius;
 
-	Material<Sphere> material;
+	// Index into the renderer's material table.
+	std::uint32_t material;
 };
 
 #endif
\ No newline at end of file
@@ -1,30 +1,89 @@
 #ifndef GI_BAH8454_TRIANGLE
 #define GI_BAH8454_TRIANGLE
 
+#include <cstdint>
 #include <tuple>
 #include <optional>
 
 #include "../util.hpp"
 #include "../ray.hpp"
 #include "../material.hpp"
+#include "../bvh/aabb.hpp"
+#include "../bvh/ray_packet.hpp"
 
 template <typename AttributeType> using Attribute = Array<AttributeType, 3>;
 
 template <typename Self>
 class Triangle {
 public:
-	Triangle(const Vector3H& v0, const Vector3H& v1, const Vector3H& v2, const Material<Self>& material) : world_vertices{ v0, v1, v2 }, material{ material } {}
-
-	// TODO: We might want to move these vectors with rvalue references.
-	Optional<Tuple<Vector3, Vector3>> intersects(const Ray& ray) const { // TODO: Actually figure out what the heck this is doing.
-		// Obtain the vertex positions.
-		const Vector3& v0 = this->camera_vertices[0];
-		const Vector3& v1 = this->camera_vertices[1];
-		const Vector3& v2 = this->camera_vertices[2];
-		// Compute the edges.
-		Vector3 e1 = v1 - v0;
-		Vector3 e2 = v2 - v0;
-		// Compute the normal to the triangle.
+	Triangle(const Vector3H& v0, const Vector3H& v1, const Vector3H& v2, std::uint32_t material) : world_vertices{ v0, v1, v2 }, material{ material } {}
+
+	// Watertight tests never let rays slip through edges shared by neighbouring triangles; the Möller-Trumbore test is cheaper but can.
+	static constexpr bool watertight = true;
+
+	Optional<Hit> intersects(const Ray& ray) const {
+		if constexpr (Triangle::watertight) {
+			return this->intersects_watertight(ray);
+		} else {
+			return this->intersects_moller_trumbore(ray);
+		}
+	}
+
+	Vector3 get_normal(const Vector3&, const Hit&) const {
+		return this->camera_normal;
+	}
+
+	/// @brief Watertight ray/triangle test (Woop, Benthin and Wald 2013).
+	Optional<Hit> intersects_watertight(const Ray& ray) const {
+		// Fusing the edge function products into FMAs rounds a shared edge differently for its two triangles, reopening the cracks.
+#ifdef __clang__
+#pragma clang fp contract(off)
+#endif
+		int kx = ray.axes[0];
+		int ky = ray.axes[1];
+		int kz = ray.axes[2];
+		// Translate the vertices to the ray origin.
+		Vector3 a = this->camera_vertices[0] - ray.origin;
+		Vector3 b = this->camera_vertices[1] - ray.origin;
+		Vector3 c = this->camera_vertices[2] - ray.origin;
+		// Shear and scale the vertices so the ray points along +z.
+		Real ax = a[kx] - ray.shear.x() * a[kz];
+		Real ay = a[ky] - ray.shear.y() * a[kz];
+		Real bx = b[kx] - ray.shear.x() * b[kz];
+		Real by = b[ky] - ray.shear.y() * b[kz];
+		Real cx = c[kx] - ray.shear.x() * c[kz];
+		Real cy = c[ky] - ray.shear.y() * c[kz];
+		// Scaled barycentric coordinates from 2D edge functions.
+		Real u = cx * by - cy * bx;
+		Real v = ax * cy - ay * cx;
+		Real w = bx * ay - by * ax;
+		// Edge functions exactly on an edge are recomputed in double precision so the edge is owned by exactly one side.
+		if (u == 0 || v == 0 || w == 0) {
+			u = static_cast<Real>(static_cast<double>(cx) * by - static_cast<double>(cy) * bx);
+			v = static_cast<Real>(static_cast<double>(ax) * cy - static_cast<double>(ay) * cx);
+			w = static_cast<Real>(static_cast<double>(bx) * ay - static_cast<double>(by) * ax);
+		}
+		// Return if we're outside of the triangle (the edge functions disagree on sign).
+		if ((u < 0 || v < 0 || w < 0) && (u > 0 || v > 0 || w > 0)) {
+			return {};
+		}
+		Real determinant = u + v + w;
+		if (determinant == 0) {
+			return {};
+		}
+		// Scaled hit distance.  It must share the determinant's sign for the hit to lie in front of the ray.
+		Real t_scaled = ray.shear.z() * (u * a[kz] + v * b[kz] + w * c[kz]);
+		if ((determinant < 0 && t_scaled >= 0) || (determinant > 0 && t_scaled <= 0)) {
+			return {};
+		}
+		Real inverse_determinant = 1 / determinant;
+		return { { .distance = t_scaled * inverse_determinant, .barycentric = Vector3{ u, v, w } * inverse_determinant } };
+	}
+
+	/// @brief Möller-Trumbore ray/triangle test using the edges precomputed by obtain_camera_coordinates.
+	Optional<Hit> intersects_moller_trumbore(const Ray& ray) const {
+		const Vector3& e1 = this->camera_edges[0];
+		const Vector3& e2 = this->camera_edges[1];
 		Vector3 ray_cross_e2 = ray.direction.cross(e2);
 		Real a = e1.dot(ray_cross_e2);
 		// Make sure we're not parallel to the triangle.
@@ -33,7 +92,7 @@ public:
 		}
 		// Compute u.
 		Real f = 1 / a;
-		Vector3 s = ray.origin - v0;
+		Vector3 s = ray.origin - this->camera_vertices[0];
 		Real u = f * s.dot(ray_cross_e2);
 		// Return if we're outside of the triangle.
 		if (u < 0 || u > 1) {
@@ -51,18 +110,118 @@ public:
 		if (t < 0) {
 			return {};
 		}
-		// Compute the intersection position.
-		Vector3 intersection_point = ray.origin + t * ray.direction;
-		// Compute the normal.
-		Vector3 normal = e1.cross(e2).normalized();
-		// Return.
-		return { { intersection_point, -normal } };
+		return { { .distance = t, .barycentric = Vector3{ 1 - u - v, u, v } } };
+	}
+
+	/// @brief Watertight test of every lane of a packet at once.
+	/// Packets whose rays do not share an axis permutation, and lanes exactly on an edge, fall back to the single ray test so results match it bit for bit.
+	template <std::size_t size>
+	HitPacket<size> intersects(const RayPacket<size>& packet) const {
+#ifdef __clang__
+#pragma clang fp contract(off)
+#endif
+		using Vector = RealVector<size>;
+		Vector infinity = Vector{} + std::numeric_limits<Real>::infinity();
+		HitPacket<size> hits{ .distance = infinity };
+		if (!Triangle::watertight || !packet.common_axes) {
+			for (std::size_t lane = 0; lane < packet.count; ++lane) {
+				this->intersects_lane(packet, lane, hits);
+			}
+			return hits;
+		}
+		int kx = packet.axes[0];
+		int ky = packet.axes[1];
+		int kz = packet.axes[2];
+		// Translate the vertices to the ray origins.
+		Vector a_x = this->camera_vertices[0][kx] - packet.origin[kx];
+		Vector a_y = this->camera_vertices[0][ky] - packet.origin[ky];
+		Vector a_z = this->camera_vertices[0][kz] - packet.origin[kz];
+		Vector b_x = this->camera_vertices[1][kx] - packet.origin[kx];
+		Vector b_y = this->camera_vertices[1][ky] - packet.origin[ky];
+		Vector b_z = this->camera_vertices[1][kz] - packet.origin[kz];
+		Vector c_x = this->camera_vertices[2][kx] - packet.origin[kx];
+		Vector c_y = this->camera_vertices[2][ky] - packet.origin[ky];
+		Vector c_z = this->camera_vertices[2][kz] - packet.origin[kz];
+		// Shear and scale the vertices so the rays point along +z.
+		Vector ax = a_x - packet.shear[0] * a_z;
+		Vector ay = a_y - packet.shear[1] * a_z;
+		Vector bx = b_x - packet.shear[0] * b_z;
+		Vector by = b_y - packet.shear[1] * b_z;
+		Vector cx = c_x - packet.shear[0] * c_z;
+		Vector cy = c_y - packet.shear[1] * c_z;
+		// Scaled barycentric coordinates from 2D edge functions.
+		Vector u = cx * by - cy * bx;
+		Vector v = ax * cy - ay * cx;
+		Vector w = bx * ay - by * ax;
+		Vector determinant = u + v + w;
+		Vector t_scaled = packet.shear[2] * (u * a_z + v * b_z + w * c_z);
+		Vector inverse_determinant = 1 / determinant;
+		// The same rejections as the single ray test, per lane.
+		auto on_edge = (u == 0) | (v == 0) | (w == 0);
+		auto outside = ((u < 0) | (v < 0) | (w < 0)) & ((u > 0) | (v > 0) | (w > 0));
+		auto behind = ((determinant < 0) & (t_scaled >= 0)) | ((determinant > 0) & (t_scaled <= 0));
+		auto miss = on_edge | outside | (determinant == 0) | behind;
+		hits.distance = miss ? infinity : t_scaled * inverse_determinant;
+		hits.barycentric[0] = u * inverse_determinant;
+		hits.barycentric[1] = v * inverse_determinant;
+		hits.barycentric[2] = w * inverse_determinant;
+		for (std::size_t lane = 0; lane < packet.count; ++lane) {
+			if (on_edge[lane]) { this->intersects_lane(packet, lane, hits); }
+		}
+		return hits;
+	}
+
+	/// @brief Single ray test of one lane of a packet, written into the packet's hits.
+	template <std::size_t size>
+	void intersects_lane(const RayPacket<size>& packet, std::size_t lane, HitPacket<size>& hits) const {
+		Optional<Hit> hit = this->intersects(*packet.rays[lane]);
+		if (!hit) {
+			hits.distance[lane] = std::numeric_limits<Real>::infinity();
+			return;
+		}
+		hits.distance[lane] = hit->distance;
+		for (int i = 0; i < 3; ++i) {
+			hits.barycentric[i][lane] = hit->barycentric[i];
+		}
 	}
 
 	void obtain_camera_coordinates(const Matrix3H& view) {
 		for (std::size_t i = 0; i < 3; ++i) {
 			this->camera_vertices[i] = from_homogeneous(view * this->world_vertices[i]);
 		}
+		// Precompute the per-frame data intersection tests would otherwise recompute for every ray.
+		this->camera_edges[0] = this->camera_vertices[1] - this->camera_vertices[0];
+		this->camera_edges[1] = this->camera_vertices[2] - this->camera_vertices[0];
+		this->camera_normal = -this->camera_edges[0].cross(this->camera_edges[1]).normalized();
+	}
+
+	AABB get_bounds() const {
+		AABB bounds{};
+		for (const Vector3& vertex : this->camera_vertices) {
+			bounds.grow(vertex);
+		}
+		return bounds;
+	}
+
+	/// @brief Bounds of the part of the triangle between two planes perpendicular to axis.
+	AABB get_clipped_bounds(int axis, Real minimum, Real maximum) const {
+		// The clipped polygon's corners are the vertices inside the slab plus the points where edges cross its planes.
+		AABB bounds{};
+		for (std::size_t i = 0; i < 3; ++i) {
+			const Vector3& a = this->camera_vertices[i];
+			const Vector3& b = this->camera_vertices[(i + 1) % 3];
+			if (a[axis] >= minimum && a[axis] <= maximum) {
+				bounds.grow(a);
+			}
+			for (Real plane : { minimum, maximum }) {
+				if ((a[axis] - plane) * (b[axis] - plane) < 0) {
+					Vector3 crossing = a + ((plane - a[axis]) / (b[axis] - a[axis])) * (b - a);
+					crossing[axis] = plane;
+					bounds.grow(crossing);
+				}
+			}
+		}
+		return bounds;
 	}
 
 	Vector3 get_barycentric_coordinate(const Vector3& position) const {
@@ -84,6 +243,16 @@ public:
 		return Vector3{ lambda0, lambda1, lambda2 };
 	}
 
+	/// @brief Interpolates a per-vertex attribute with the barycentric weights of a hit.
+	template <typename AttributeType>
+	AttributeType interpolate(const Vector3& barycentric, const Attribute<AttributeType>& attribute) const {
+		return (
+			attribute[0] * barycentric[0] +
+			attribute[1] * barycentric[1] +
+			attribute[2] * barycentric[2]
+		);
+	}
+
 	template <typename AttributeType>
 	AttributeType get_interpolated_attribute(Vector3 position, const Attribute<AttributeType>& attribute) const {
 		Vector3 lambda = this->get_barycentric_coordinate(position);
@@ -96,8 +265,11 @@ public:
 
 	Array<Vector3H, 3> world_vertices;
 	Array<Vector3, 3> camera_vertices;
+	Array<Vector3, 2> camera_edges;
+	Vector3 camera_normal;
 	
-	Material<Self> material;
+	// Index into the renderer's material table.
+	std::uint32_t material;
 };
 
 class UVTriangle : public Triangle<UVTriangle> {
@@ -105,15 +277,24 @@ public:
 	UVTriangle(
 		const Attribute<Vector3H>& vertices,
 		const Attribute<Vector2>& uv,
-		const Material<UVTriangle>& material
+		std::uint32_t material = 0
 	) : uv{ uv }, Triangle<UVTriangle>(vertices[0], vertices[1], vertices[2], material) {};
 
+	/// @brief UV units per unit of length across the triangle (the square root of the ratio of its UV and camera space areas).
+	Real get_uv_density() const {
+		Real area = (this->camera_vertices[1] - this->camera_vertices[0]).cross(this->camera_vertices[2] - this->camera_vertices[0]).norm();
+		Vector2 a = this->uv[1] - this->uv[0];
+		Vector2 b = this->uv[2] - this->uv[0];
+		Real uv_area = std::abs(a.x() * b.y() - b.x() * a.y());
+		return area > 0 ? std::sqrt(uv_area / area) : 0;
+	}
+
 	Attribute<Vector2> uv;
 };
 
 class PhongTriangle : public Triangle<PhongTriangle> {
 public:
-	PhongTriangle(const Vector3H& v0, const Vector3H& v1, const Vector3H& v2) : Triangle<PhongTriangle>(v0, v1, v2, {}) {};
+	PhongTriangle(const Vector3H& v0, const Vector3H& v1, const Vector3H& v2, std::uint32_t material = 0) : Triangle<PhongTriangle>(v0, v1, v2, material) {};
 };
 
 #endif
\ No newline at end of file
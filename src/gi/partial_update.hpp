@@ -0,0 +1,91 @@
+#ifndef GI_BAH8454_PARTIAL_UPDATE
+#define GI_BAH8454_PARTIAL_UPDATE
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "util.hpp"
+
+/// @brief A rectangle of pixels of the frame buffer.
+class Tile {
+public:
+	std::uint32_t x;
+	std::uint32_t y;
+	std::uint32_t width;
+	std::uint32_t height;
+
+	bool overlaps(const Tile& other) const {
+		return this->x < other.x + other.width && other.x < this->x + this->width && this->y < other.y + other.height && other.y < this->y + this->height;
+	}
+
+	bool operator==(const Tile& other) const = default;
+};
+
+/// @brief Chooses which tiles of the frame to redraw, so large frames update sooner while the view changes, at the cost of the other tiles lagging behind.
+class PartialUpdate {
+public:
+	enum class Pattern : std::uint32_t {
+		// Every tile, every frame.
+		full,
+		// Every other row of tiles, alternating between frames.
+		interlaced,
+		// Every other tile like the squares of a checkerboard, alternating between frames.
+		checkerboard,
+		// The tiles overlapping a region of interest, such as around the client's mouse; every tile while there is none.
+		region
+	};
+
+	class Info {
+	public:
+		Pattern pattern = Pattern::full;
+		// Width and height of the tiles in pixels.
+		std::uint32_t tile_size = 32;
+	};
+
+	PartialUpdate(const Info& info) : pattern{ info.pattern }, tile_size{ std::max<std::uint32_t>(info.tile_size, 1) } {}
+
+	/// @brief Sets the region of interest, or clears it with an empty one.
+	void set_region(const Tile& region) {
+		this->region = region;
+	}
+
+	/// @brief The tiles to redraw in a frame of the given size, clipped to it, or none to redraw the whole frame.
+	/// @param frame_index Alternates the interlaced and checkerboard patterns.
+	std::vector<Tile> get_tiles(std::size_t width, std::size_t height, std::uint32_t frame_index) const {
+		std::vector<Tile> tiles;
+		bool has_region = this->region.width > 0 && this->region.height > 0;
+		if (this->pattern == Pattern::full || (this->pattern == Pattern::region && !has_region)) {
+			return tiles;
+		}
+		for (std::uint32_t row = 0; row * this->tile_size < height; ++row) {
+			for (std::uint32_t column = 0; column * this->tile_size < width; ++column) {
+				Tile tile{
+					column * this->tile_size,
+					row * this->tile_size,
+					std::min<std::uint32_t>(this->tile_size, static_cast<std::uint32_t>(width) - column * this->tile_size),
+					std::min<std::uint32_t>(this->tile_size, static_cast<std::uint32_t>(height) - row * this->tile_size)
+				};
+				bool drawn = true;
+				if (this->pattern == Pattern::interlaced) {
+					drawn = row % 2 == frame_index % 2;
+				} else if (this->pattern == Pattern::checkerboard) {
+					drawn = (row + column) % 2 == frame_index % 2;
+				} else if (this->pattern == Pattern::region) {
+					drawn = tile.overlaps(this->region);
+				}
+				if (drawn) {
+					tiles.push_back(tile);
+				}
+			}
+		}
+		return tiles;
+	}
+
+	Pattern pattern;
+	std::uint32_t tile_size;
+	// Pixels of the frame to keep up to date under Pattern::region.
+	Tile region{ 0, 0, 0, 0 };
+};
+
+#endif
\ No newline at end of file
@@ -8,10 +8,36 @@ public:
 	Ray() {}
 	Ray(const Vector3& origin, const Vector3& direction) :
 		origin{ origin }, direction{ direction.normalized() }
-	{}
+	{
+		// Precompute the transformation watertight triangle tests use (Woop et al. 2013): permute the axes so the dominant direction component is z, then shear the direction onto +z.
+		Vector3 magnitude = this->direction.cwiseAbs();
+		int kz = magnitude.x() > magnitude.y() ? (magnitude.x() > magnitude.z() ? 0 : 2) : (magnitude.y() > magnitude.z() ? 1 : 2);
+		int kx = (kz + 1) % 3;
+		int ky = (kx + 1) % 3;
+		// Swap x and y to preserve the triangle winding.
+		if (this->direction[kz] < 0) { std::swap(kx, ky); }
+		this->axes = { kx, ky, kz };
+		this->shear = {
+			this->direction[kx] / this->direction[kz],
+			this->direction[ky] / this->direction[kz],
+			1 / this->direction[kz]
+		};
+	}
 
 	Vector3 origin{ 0, 0, 0 };
 	Vector3 direction{ 0, 0, 0 };
+	// Axis permutation and shear for watertight triangle intersection.
+	Array<int, 3> axes{ 0, 1, 2 };
+	Vector3 shear{ 0, 0, 0 };
+};
+
+/// @brief The minimum an intersection test reports.  Position, normal and other attributes are only reconstructed for the closest hit.
+class Hit {
+public:
+	// Distance along the (normalized) ray.
+	Real distance;
+	// Weights of the three vertices at the hit (triangles only).
+	Vector3 barycentric{ 0, 0, 0 };
 };
 
 #endif
\ No newline at end of file
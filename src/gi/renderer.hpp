@@ -17,25 +17,72 @@ namespace beast = boost::beast;
 #include <algorithm>
 #include <string_view>
 #include <string>
+#include <random>
+#include <numeric>
+#include <vector>
+#include <optional>
+#include <memory>
+#include <thread>
+#include <exception>
 
 #include "util.hpp"
 #include "frame_buffer.hpp"
 #include "camera.hpp"
 #include "light.hpp"
+#include "sampling.hpp"
 #include "material.hpp"
+#include "texture.hpp"
+#include "environment.hpp"
+#include "partial_update.hpp"
+#include "tile_coordinator.hpp"
+#include "device_split.hpp"
+#include "shader_registry.hpp"
 #include "object/renderable_object.hpp"
+#include "bvh/bvh.hpp"
+#include "bvh/ray_packet.hpp"
+#include "bvh/ray_stream.hpp"
+#include "wavefront.hpp"
 
 #include "../ply/happly.hpp"
 
-template <RenderableObject... ObjectTypes>
+/// @tparam Shaders The ShaderRegistry of the shaders materials can use.
+template <typename Shaders, RenderableObject... ObjectTypes>
 class Renderer {
 public:
     using Object = Variant<ObjectTypes...>;
+    // The object a ray hit, the hit position and normal, and the hit itself.
+    using Collision = Tuple<const Object*, Vector3, Vector3, Hit>;
+
+    /// @brief How primary rays are traced.  Secondary rays diverge and are always traced one at a time.
+    enum class Traversal {
+        single,
+        // Tiles of 2x2, 4x2 or 4x4 pixels traced together in vector lanes.
+        packet,
+        // Every primary ray of the frame as one batch.
+        stream
+    };
+
+    enum class Integrator {
+        // illuminate: intersection, shading and recursion per pixel.
+        recursive,
+        // Generate, extend, shadow and shade stages launched as separate kernels over ray queues.
+        wavefront
+    };
 
     class Callbacks {
     public:
-        std::function<void(Renderer<ObjectTypes...>&)> on_load;
-        std::function<void(Renderer<ObjectTypes...>&, Real)> on_frame;
+        std::function<void(Renderer&)> on_load;
+        std::function<void(Renderer&, Real)> on_frame;
+    };
+
+    /// @brief Rendering fewer pixels when frames take too long, and upscaling them to the frame buffer's size.
+    class DynamicResolution {
+    public:
+        bool enabled = false;
+        // Seconds a frame should take.
+        Real target_frame_time = 1_r / 30;
+        // Smallest fraction of the frame buffer's width and height to render at.
+        Real minimum_scale = 0.25;
     };
 
     class Info {
@@ -43,19 +90,74 @@ public:
         FrameBuffer::Info frame_buffer;
         Camera::Info camera;
         Callbacks callbacks;
+        BVH::Info bvh;
+        TextureStore::Info textures;
+        Integrator integrator = Integrator::recursive;
+        // Only used by the wavefront integrator: shade hits grouped by object type and material, and trace secondary rays grouped by direction octant and origin.
+        bool sort_hits = false;
+        bool sort_rays = false;
+        // Only used by the recursive integrator.
+        Traversal traversal = Traversal::packet;
+        // Rays per packet: 4, 8 or 16.
+        std::size_t packet_size = 16;
+        // Direct lighting from lights with area: samples per light at every hit, and how they are drawn.
+        std::size_t light_samples = 4;
+        LightSampling light_sampling = LightSampling::multiple_importance;
+        // Seen by rays that escape the scene and lighting it, until an environment map is loaded.
         Vector3 background_color{ 0, 0, 0 };
+        DynamicResolution dynamic_resolution;
+        // Which tiles streamed frames redraw.
+        PartialUpdate::Info partial_update;
+        // Worker processes to draw frames on instead of this device.
+        TileCoordinator::Info distribution;
+        // SYCL devices of this machine to split frames between.
+        DeviceSplit::Info devices;
     };
 
-    Renderer(const Info& info) :
-        q{ sycl::gpu_selector{} },
+    Renderer(const Info& info) : Renderer{ info, DeviceSplit::get_devices(info.devices) } {}
+
+    /// @param devices The devices to draw on, this renderer's first; the GPU selector's if none.
+    Renderer(const Info& info, const std::vector<sycl::device>& devices) :
+        q{ devices.empty() ? sycl::queue{ sycl::gpu_selector{} } : sycl::queue{ devices.front() } },
         objects{ SharedAllocator<Object>{this->q} },
         lights{ SharedAllocator<Object>{this->q} },
+        materials{ SharedAllocator<Material>{this->q} },
+        textures{ this->q, info.textures },
+        environment{ this->q, info.background_color },
+        bvh{ this->q, info.bvh },
+        integrator{ info.integrator },
+        sort_hits{ info.sort_hits },
+        sort_rays{ info.sort_rays },
+        traversal{ info.traversal },
+        packet_size{ info.packet_size },
+        light_samples{ info.light_samples },
+        light_sampling{ info.light_sampling },
+        dynamic_resolution{ info.dynamic_resolution },
+        partial_update{ info.partial_update },
         frame_buffer{ this->q, info.frame_buffer },
         camera{ this->q, info.camera, info.frame_buffer },
-        callbacks{ info.callbacks }
+        callbacks{ info.callbacks },
+        device_split{ info.devices, devices.size() },
+        paths{ this->q },
+        next_paths{ this->q },
+        hits{ this->q },
+        queue_sorter{ this->q },
+        tile_pixels{ SharedAllocator<std::uint32_t>{ this->q } }
     {
+        if (!info.distribution.workers.empty()) {
+            this->coordinator.emplace(info.distribution);
+        }
+        // Material 0 is the default: the first shader, colored by the normal.
+        this->add_material({ .albedo_source = Material::Albedo::normal });
         // Perform code the user wants run before the session starts.
         this->callbacks.on_load(*this);
+        // The other devices load the scene the same way.
+        Info device_info = info;
+        device_info.distribution.workers.clear();
+        device_info.dynamic_resolution.enabled = false;
+        for (std::size_t d = 1; d < devices.size(); ++d) {
+            this->device_renderers.push_back(std::make_unique<Renderer>(device_info, std::vector<sycl::device>{ devices[d] }));
+        }
         // KD Tree.
         // auto start = std::chrono::high_resolution_clock::now();
         // for (auto& object : this->objects) {
@@ -73,48 +175,11 @@ public:
         //std::cout << this->q.get_device().template get_info<sycl::info::device::name>() << std::endl;
     }
 
-    // template <typename... Ts>
-    // void register_shaders_with_device(Ts... functions) {
-    //     this->q.parallel_for({1}, [](std::size_t i) {
-             
-    //     });
-    // }
-
-    void render() {
+    /// @param tiles The tiles of the frame buffer to draw, leaving the other pixels as the previous frame left them; every pixel if empty.
+    void render(const std::vector<Tile>& tiles = {}) {
         // Start the delta timer.
         auto start = std::chrono::high_resolution_clock::now();
-        // Make sure all of the objects are in camera coordinates.
-        this->q.parallel_for(
-            {this->objects.size()},
-            [
-                objects = this->objects.data(),
-                camera_view = this->camera.view
-            ](std::size_t i) {
-                visit([&](auto& object) { object.obtain_camera_coordinates(*camera_view); }, objects[i]);
-            }
-        ).wait();
-        // Make sure all of the lights are in camera coordinates.
-        this->q.parallel_for(
-            {this->lights.size()},
-            [lights = this->lights.data(), camera_view = this->camera.view](std::size_t i) {
-                lights[i].obtain_camera_coordinates(*camera_view);
-            }
-        ).wait();
-        // Draw each pixel.
-        for (std::size_t i = 0; i < this->frame_buffer.width * this->frame_buffer.height; ++i) {
-            auto data = DeviceData<Object>{
-                .view = this->camera.view,
-                .film_plane = this->camera.film_plane,
-                .rays = this->camera.rays,
-                .pixels = this->frame_buffer.pixels,
-                .objects = this->objects.data(),
-                .object_count = this->objects.size(),
-                .lights = this->lights.data(),
-                .light_count = this->lights.size()
-            };
-            Vector3 color = Renderer::illuminate(data, data.rays[i]);
-            data.pixels[i] = color;
-        }
+        Real draw_time = this->draw_frame(tiles);
         // this->q.parallel_for(
         //     { this->frame_buffer.width * this->frame_buffer.height },
         //     [
@@ -146,72 +211,53 @@ public:
         // Tone reproduction.
         //this->frame_buffer.tone_reproduction_adaptive_logarithmic_mapping();
         this->frame_buffer.tone_reproduction_ward();
+        this->frame_buffer.upscale();
+        this->adjust_resolution(std::chrono::duration<Real>{ std::chrono::high_resolution_clock::now() - start }.count(), draw_time);
+    }
+
+    /// @brief Draws and tone maps a frame of the scene as it is, without calling on_frame or changing the resolution.
+    void render_still() {
+        this->draw_frame({});
+        this->frame_buffer.tone_reproduction_ward();
+        this->frame_buffer.upscale();
+    }
+
+    /// @brief Draws tiles of a frame for a TileCoordinator, leaving their radiance in the frame buffer without tone mapping or calling back.
+    /// @param frame_index The coordinator's frame, whose random numbers to use.
+    /// @param prepare Whether to transform the scene and rebuild the BVH, needed unless the camera and frame are the same as the last call's.
+    void draw_tiles(const std::vector<Tile>& tiles, std::uint32_t frame_index, bool prepare) {
+        this->frame_index = frame_index;
+        if (prepare) {
+            this->prepare_frame();
+        }
+        this->draw_devices(tiles);
     }
 
     static Vector3 illuminate(const DeviceData<Object>& data, const Ray& ray, std::size_t depth = 0) {
+        return Renderer::illuminate(data, ray, Renderer::get_nearest_collision(data, ray), depth);
+    }
+
+    /// @brief Shades a ray whose nearest collision has already been found.
+    static Vector3 illuminate(const DeviceData<Object>& data, const Ray& ray, const Optional<Collision>& collision, std::size_t depth = 0) {
+        // Lights with area in front of the collision are seen directly.
+        if (auto emitted = Renderer::get_emitted_light(data, ray, collision ? get<3>(*collision).distance : std::numeric_limits<Real>::infinity())) {
+            return *emitted;
+        }
         // Check if there was a collision.
-        if (auto success = Renderer::get_nearest_collision(data, ray)) {
-            auto [object, position, normal] = *success;
-            MaterialInfo material_info{ .position = position, .normal = normal, .light_position = data.lights[0].camera_position, .light_color = data.lights[0].color }; // TODO: Allow more than one light.
-            Vector3 offset_position = position + (0.001 * normal); // TODO: Define epsilon.
-            Vector3 shadow_ray_direction = (data.lights[0].camera_position - offset_position);
-            Ray shadow_ray{ offset_position, shadow_ray_direction };
-            Real distance_to_light = (data.lights[0].camera_position - offset_position).norm();
-            Vector3 color;
-            if (Renderer::get_nearest_collision(data, shadow_ray, distance_to_light)) {
-                // This pixel is in shadow.
-                visit([&](const auto& object) {
-                    color = { 0, 0, 0 };
-                }, *object); // TODO: Use optional reference instead of pointer.
-                //color = Renderer::shader_hack(*object, material_info); // TODO: Remove this.
-            } else {
-                // Update the pixel color corresponding to this ray.
-                color = Renderer::shader_hack(*object, material_info);
-            }
-            // Reflection and transmission.
-            Real reflection_constant = visit([](const auto& object) { return object.material.reflection_constant; }, *object);
-            Real transmission_constant = visit([](const auto& object) { return object.material.transmission_constant; }, *object);
-            Real medium_index = visit([](const auto& object) { return object.material.medium_index; }, *object);
-            if (depth > 5) { return color; } // TODO: Make max depth configurable.
-            if (reflection_constant > 0) {
-                // Perform reflection recursion.
-                Ray reflection_ray = {
-                    position + (0.001 * normal), // TODO: Define epsilon.
-                    ray.direction - 2 * (ray.direction.dot(normal)) * normal
-                };
-                return (1 - reflection_constant) * color + reflection_constant * Renderer::illuminate(data, reflection_ray, depth + 1);
-            }
-            if (transmission_constant > 0) {
-                // Perform transmission recursion.
-                Real eta = 1 / medium_index;
-                Vector3 ray_direction = ray.direction;
-                if (normal.dot(-ray_direction) < 0) {
-                    normal = -normal;
-                    eta = 1.0 / eta;
-                }
-                Real cos_theta_i = -normal.dot(ray_direction);
-                Real sin_theta_t_squared = eta * eta * (1.0 - cos_theta_i * cos_theta_i);
-                Real cos_theta_t = std::sqrt(1.0 - sin_theta_t_squared);
-                if (sin_theta_t_squared > 1.0) {
-                    // Total internal reflection
-                    Ray total_internal_reflection_ray = {
-                        position + (0.001 * normal), // TODO: Define epsilon.
-                        ray_direction - 2 * (ray_direction.dot(normal)) * normal
-                    };
-                    return (1 - transmission_constant) * color + transmission_constant * Renderer::illuminate(data, total_internal_reflection_ray, depth + 1);
-                }
-                Ray transmission_ray = {
-                    position - (0.001 * normal), // TODO: Define epsilon.
-                    eta * ray_direction + (eta * cos_theta_i - cos_theta_t) * normal
-                };
-                return (1 - transmission_constant) * color + transmission_constant * Renderer::illuminate(data, transmission_ray, depth + 1);
-            }
-            return color;
-        } else {
-            // If the ray hasn't hit anything, it should display the background color.
-            //return this->background_color.data(); // TODO: Implement background_color.
-            return { 0, 0, 0 };
+        if (!collision) {
+            // If the ray hasn't hit anything, it should display the environment.
+            return data.environment->get_radiance(ray.direction);
+        }
+        auto [shadow_ray, distance_to_light] = Renderer::get_shadow_ray(data, *collision);
+        bool occluded = Renderer::get_nearest_collision(data, shadow_ray, distance_to_light, true).has_value();
+        Vector3 color = Renderer::get_surface_color(data, *collision, occluded);
+        if (depth > 5) { return color; } // TODO: Make max depth configurable.
+        // Reflection and transmission.
+        if (auto secondary = Renderer::get_secondary_ray(data, ray, *collision)) {
+            auto [secondary_ray, weight] = *secondary;
+            return (1 - weight) * color + weight * Renderer::illuminate(data, secondary_ray, depth + 1);
         }
+        return color;
     }
 
     sycl::queue q;
@@ -219,6 +265,23 @@ public:
     Shared<Object, SharedAllocator<Object>> objects;
     //KDTreeNode<PhongTriangle> tree;
     Shared<Light, SharedAllocator<Light>> lights;
+    Shared<Material, SharedAllocator<Material>> materials;
+    TextureStore textures;
+    Environment environment;
+
+    BVH bvh;
+
+    Integrator integrator;
+    bool sort_hits;
+    bool sort_rays;
+    Traversal traversal;
+    std::size_t packet_size;
+    std::size_t light_samples;
+    LightSampling light_sampling;
+    DynamicResolution dynamic_resolution;
+    PartialUpdate partial_update;
+    // Fraction of the frame buffer's width and height rendered last frame.
+    Real resolution_scale = 1;
 
     FrameBuffer frame_buffer;
 
@@ -226,72 +289,987 @@ public:
 
     Callbacks callbacks;
 
+    // Draws frames on worker processes, if there are any.
+    std::optional<TileCoordinator> coordinator;
+
+    // Shares of each frame for this renderer's device and the others, when there are several; get_shares tells how the next frame is split.
+    DeviceSplit device_split;
+    // Renderers with copies of the scene on the devices after the first.
+    std::vector<std::unique_ptr<Renderer>> device_renderers;
+
 private:
-    static Optional<Tuple<const Object*, Vector3, Vector3>> get_nearest_collision(
-        const DeviceData<Object>& data,
-        const Ray& ray,
-        Real maximum_distance = std::numeric_limits<Real>::infinity()
+    /// @brief Brings another device's renderer up to date with this one's scene, camera and settings for the frame about to be drawn.
+    /// The scene is copied every frame, so on_frame can animate it; that takes less time than the BVH build each device does anyway.
+    void replicate(Renderer& renderer) const {
+        renderer.objects.assign(this->objects.begin(), this->objects.end());
+        renderer.lights.assign(this->lights.begin(), this->lights.end());
+        renderer.materials.assign(this->materials.begin(), this->materials.end());
+        *renderer.camera.view = *this->camera.view;
+        if (renderer.frame_buffer.width != this->frame_buffer.width || renderer.frame_buffer.height != this->frame_buffer.height) {
+            renderer.frame_buffer.resize(this->frame_buffer.width, this->frame_buffer.height);
+            renderer.camera.resize(this->frame_buffer.width, this->frame_buffer.height);
+        }
+        renderer.integrator = this->integrator;
+        renderer.sort_hits = this->sort_hits;
+        renderer.sort_rays = this->sort_rays;
+        renderer.traversal = this->traversal;
+        renderer.packet_size = this->packet_size;
+        renderer.light_samples = this->light_samples;
+        renderer.light_sampling = this->light_sampling;
+        renderer.frame_index = this->frame_index;
+    }
+
+    /// @brief Draws each pixel of the tiles, on the tile workers if there are any; they hold the scene themselves.
+    /// @return Seconds spent drawing, after the scene was prepared.
+    Real draw_frame(const std::vector<Tile>& tiles) {
+        auto draw_start = std::chrono::high_resolution_clock::now();
+        bool distributed = this->coordinator && this->coordinator->draw(
+            this->frame_buffer.pixels, *this->camera.view, this->frame_buffer.output_width, this->frame_buffer.output_height,
+            this->frame_buffer.width, this->frame_buffer.height, this->frame_index, tiles
+        );
+        if (!distributed) {
+            this->prepare_frame();
+            draw_start = std::chrono::high_resolution_clock::now();
+            this->draw_devices(tiles);
+        }
+        ++this->frame_index;
+        return std::chrono::duration<Real>{ std::chrono::high_resolution_clock::now() - draw_start }.count();
+    }
+
+    /// @brief Sends a frame's tiles to every device, each drawing its share with its own renderer on a thread of its own, and gathers them into this frame buffer.
+    /// Only the wavefront integrator shades on the devices themselves; see DeviceSplit.
+    void draw_devices(const std::vector<Tile>& tiles) {
+        if (this->device_renderers.empty()) {
+            return this->draw(this->get_device_data(), tiles);
+        }
+        std::vector<std::vector<Tile>> shares = this->device_split.split(this->frame_buffer.width, this->frame_buffer.height, tiles);
+        std::vector<Real> draw_times(shares.size(), 0);
+        std::vector<std::exception_ptr> exceptions(shares.size());
+        {
+            // The other devices draw on threads of their own while this one draws on the caller's.
+            std::vector<std::jthread> threads;
+            for (std::size_t d = 1; d < shares.size(); ++d) {
+                if (shares[d].empty()) { continue; }
+                Renderer& renderer = *this->device_renderers[d - 1];
+                this->replicate(renderer);
+                threads.emplace_back([&renderer, &share = shares[d], &draw_time = draw_times[d], &exception = exceptions[d]]() {
+                    try {
+                        renderer.prepare_frame();
+                        auto start = std::chrono::high_resolution_clock::now();
+                        renderer.draw(renderer.get_device_data(), share);
+                        draw_time = std::chrono::duration<Real>{ std::chrono::high_resolution_clock::now() - start }.count();
+                    } catch (...) {
+                        exception = std::current_exception();
+                    }
+                });
+            }
+            if (!shares[0].empty()) {
+                auto start = std::chrono::high_resolution_clock::now();
+                this->draw(this->get_device_data(), shares[0]);
+                draw_times[0] = std::chrono::duration<Real>{ std::chrono::high_resolution_clock::now() - start }.count();
+            }
+        }
+        for (const std::exception_ptr& exception : exceptions) {
+            if (exception) {
+                std::rethrow_exception(exception);
+            }
+        }
+        // Gather the other devices' tiles.
+        for (std::size_t d = 1; d < shares.size(); ++d) {
+            const FrameBuffer& frame_buffer = this->device_renderers[d - 1]->frame_buffer;
+            for (const Tile& tile : shares[d]) {
+                std::size_t width = std::min<std::size_t>(tile.x + tile.width, this->frame_buffer.width) - std::min<std::size_t>(tile.x, this->frame_buffer.width);
+                for (std::size_t y = tile.y; y < std::min<std::size_t>(tile.y + tile.height, this->frame_buffer.height); ++y) {
+                    std::size_t offset = y * this->frame_buffer.width + tile.x;
+                    std::copy_n(frame_buffer.pixels + offset, width, this->frame_buffer.pixels + offset);
+                }
+            }
+        }
+        for (std::size_t d = 0; d < shares.size(); ++d) {
+            this->device_split.record(d, shares[d], draw_times[d]);
+        }
+    }
+
+    // Queues of the wavefront integrator.
+    RayQueue paths;
+    RayQueue next_paths;
+    HitQueue hits;
+    QueueSorter queue_sorter;
+    // Frames rendered, varying the random numbers from frame to frame.
+    std::uint32_t frame_index = 0;
+    // Indices of the pixels of the tiles drawn this frame, when not drawing all of them.
+    Shared<std::uint32_t, SharedAllocator<std::uint32_t>> tile_pixels;
+
+    DeviceData<Object> get_device_data() {
+        return {
+            .view = this->camera.view,
+            .film_plane = this->camera.film_plane,
+            .rays = this->camera.rays,
+            .pixel_spread_angle = std::atan(this->camera.film_plane->height / this->frame_buffer.height / this->camera.film_plane->distance),
+            .pixels = this->frame_buffer.pixels,
+            .objects = this->objects.data(),
+            .object_count = this->objects.size(),
+            .lights = this->lights.data(),
+            .light_count = this->lights.size(),
+            .light_samples = this->light_samples,
+            .light_sampling = this->light_sampling,
+            .frame_index = this->frame_index,
+            .materials = this->materials.data(),
+            .material_count = this->materials.size(),
+            .textures = this->textures.get_data(),
+            .environment = this->environment.get_data(),
+            .bvh_width = this->bvh.width,
+            .bvh_compressed = this->bvh.compressed,
+            .bvh_nodes = this->bvh.nodes.data(),
+            .bvh_node_count = this->bvh.nodes.size(),
+            .bvh4_nodes = this->bvh.nodes4.data(),
+            .bvh4_node_count = this->bvh.nodes4.size(),
+            .bvh8_nodes = this->bvh.nodes8.data(),
+            .bvh8_node_count = this->bvh.nodes8.size(),
+            .compressed_bvh4_nodes = this->bvh.compressed_nodes4.data(),
+            .compressed_bvh8_nodes = this->bvh.compressed_nodes8.data(),
+            .bvh_indices = this->bvh.indices.data()
+        };
+    }
+
+    /// @brief Moves the scene into camera coordinates and builds what drawing needs from it.
+    void prepare_frame() {
+        this->obtain_camera_coordinates();
+        // Rebuild the acceleration structure over the transformed objects; it times itself in bvh.build_time.
+        this->bvh.build(this->objects.data(), this->objects.size());
+        // Install streamed texture pages that arrived and request the ones missed last frame (see textures.cache.get_statistics()).
+        this->textures.update();
+    }
+
+    /// @brief Picks the resolution of the next frame so it takes the target time, if dynamic resolution is enabled.
+    /// The rest of a frame takes about as long at any resolution, while drawing takes time in proportion to the pixels drawn.
+    void adjust_resolution(Real frame_time, Real draw_time) {
+        if (!this->dynamic_resolution.enabled || draw_time <= 0) {
+            return;
+        }
+        Real pixel_time = draw_time / (this->frame_buffer.width * this->frame_buffer.height);
+        Real pixel_budget = std::max(this->dynamic_resolution.target_frame_time - (frame_time - draw_time), 0_r) / pixel_time;
+        Real scale = std::sqrt(pixel_budget / (this->frame_buffer.output_width * this->frame_buffer.output_height));
+        // Go halfway there, so one slow frame doesn't halve the resolution.
+        scale = std::clamp((this->resolution_scale + scale) / 2, this->dynamic_resolution.minimum_scale, 1_r);
+        // Ignore small changes, so the resolution settles instead of changing every frame.
+        if (std::abs(scale - this->resolution_scale) < 0.02_r && scale != 1 && scale != this->dynamic_resolution.minimum_scale) {
+            return;
+        }
+        std::size_t width = std::max<std::size_t>(static_cast<std::size_t>(std::round(this->frame_buffer.output_width * scale)), 1);
+        std::size_t height = std::max<std::size_t>(static_cast<std::size_t>(std::round(this->frame_buffer.output_height * scale)), 1);
+        this->resolution_scale = scale;
+        if (width == this->frame_buffer.width && height == this->frame_buffer.height) {
+            return;
+        }
+        this->frame_buffer.resize(width, height);
+        this->camera.resize(width, height);
+    }
+
+    /// @brief Transforms every object and light into camera coordinates.
+    void obtain_camera_coordinates() {
+        // Make sure all of the objects are in camera coordinates.
+        this->q.parallel_for(
+            {this->objects.size()},
+            [
+                objects = this->objects.data(),
+                camera_view = this->camera.view
+            ](std::size_t i) {
+                visit([&](auto& object) { object.obtain_camera_coordinates(*camera_view); }, objects[i]);
+            }
+        ).wait();
+        // Make sure all of the lights are in camera coordinates.
+        this->q.parallel_for(
+            {this->lights.size()},
+            [lights = this->lights.data(), camera_view = this->camera.view](std::size_t i) {
+                lights[i].obtain_camera_coordinates(*camera_view);
+            }
+        ).wait();
+        // Orient the environment to the camera.
+        this->environment.obtain_camera_coordinates(*this->camera.view);
+    }
+
+    /// @brief Shades every pixel of the tiles, or of the frame without tiles, tracing the primary rays with the configured traversal.
+    void draw(const DeviceData<Object>& data, const std::vector<Tile>& tiles = {}) {
+        std::vector<Tile> regions = tiles;
+        if (regions.empty()) {
+            regions.push_back(this->get_frame_tile());
+        }
+        // Packets are traced a block of pixels at a time, straight from the tiles.
+        if (this->integrator != Integrator::wavefront && this->traversal == Traversal::packet) {
+            for (const Tile& tile : regions) {
+                if (this->packet_size == 4) {
+                    this->draw_packets<4>(data, tile, 2, 2);
+                } else if (this->packet_size == 8) {
+                    this->draw_packets<8>(data, tile, 4, 2);
+                } else {
+                    this->draw_packets<16>(data, tile, 4, 4);
+                }
+            }
+            return;
+        }
+        // List the pixels of the tiles for the others, which take rays in any order.
+        this->tile_pixels.clear();
+        for (const Tile& tile : regions) {
+            for (std::size_t y = tile.y; y < std::min<std::size_t>(tile.y + tile.height, this->frame_buffer.height); ++y) {
+                for (std::size_t x = tile.x; x < std::min<std::size_t>(tile.x + tile.width, this->frame_buffer.width); ++x) {
+                    this->tile_pixels.push_back(static_cast<std::uint32_t>(y * this->frame_buffer.width + x));
+                }
+            }
+        }
+        if (this->integrator == Integrator::wavefront) {
+            this->draw_wavefront(data, this->tile_pixels.size(), this->tile_pixels.data());
+        } else if (this->traversal == Traversal::stream) {
+            this->draw_stream(data, { this->tile_pixels.begin(), this->tile_pixels.end() });
+        } else {
+            for (std::uint32_t i : this->tile_pixels) {
+                data.pixels[i] = Renderer::illuminate(data, data.rays[i]);
+            }
+        }
+    }
+
+    /// @brief The whole frame buffer as one tile.
+    Tile get_frame_tile() const {
+        return { 0, 0, static_cast<std::uint32_t>(this->frame_buffer.width), static_cast<std::uint32_t>(this->frame_buffer.height) };
+    }
+
+    /// @brief Wavefront integrator (Laine, Karras and Aila 2013).
+    /// Each stage is its own kernel over a queue of paths instead of one recursive megakernel, so work items of a launch run the same code, and paths that end drop out of the queue between bounces.
+    /// @param path_count Number of primary paths, spread evenly over the pixels (fewer than the pixel count only for benchmarking).
+    /// @param pixels The pixel of every path, instead of spreading them evenly.
+    void draw_wavefront(const DeviceData<Object>& data, std::size_t path_count, const std::uint32_t* pixels = nullptr) {
+        // Tiles clipped to nothing leave no paths to trace.
+        if (path_count == 0) { return; }
+        std::size_t pixel_stride = this->frame_buffer.width * this->frame_buffer.height / path_count;
+        this->paths.reset(path_count);
+        this->next_paths.reset(path_count);
+        this->hits.reserve(path_count);
+        this->queue_sorter.reserve(path_count);
+        RayQueue* current = &this->paths;
+        RayQueue* next = &this->next_paths;
+        // Generate: one path per pixel, starting with the camera's primary ray.
+        this->q.parallel_for(
+            { path_count },
+            [data, pixel_stride, pixels, paths = current->get_data()](std::size_t i) {
+                std::size_t pixel = pixels != nullptr ? pixels[i] : i * pixel_stride;
+                paths.origins[i] = data.rays[pixel].origin;
+                paths.directions[i] = data.rays[pixel].direction;
+                paths.pixels[i] = static_cast<std::uint32_t>(pixel);
+                paths.throughputs[i] = { 1, 1, 1 };
+                paths.depths[i] = 0;
+                data.pixels[pixel] = { 0, 0, 0 };
+            }
+        ).wait();
+        current->count[0] = static_cast<std::uint32_t>(path_count);
+        while (current->size() > 0) {
+            std::size_t count = current->size();
+            // Extend: the closest hit of every path.
+            this->q.parallel_for(
+                { count },
+                [data, paths = current->get_data(), hits = this->hits.get_data()](std::size_t i) {
+                    if (auto collision = Renderer::get_nearest_collision(data, paths.get_ray(i))) {
+                        auto& [object, position, normal, hit] = *collision;
+                        hits.objects[i] = static_cast<std::uint32_t>(object - data.objects);
+                        hits.distances[i] = hit.distance;
+                        hits.barycentrics[i] = hit.barycentric;
+                    } else {
+                        hits.objects[i] = HitQueue::no_hit;
+                    }
+                }
+            ).wait();
+            // Optionally order the hits by object type, then material, so neighbouring work items run the same shading code on the same data.
+            // The shadow and shade stages read the hits through the resulting permutation.
+            const std::uint32_t* order = nullptr;
+            if (this->sort_hits) {
+                this->q.parallel_for(
+                    { count },
+                    [data, hits = this->hits.get_data(), keys = this->queue_sorter.keys.data()](std::size_t i) {
+                        std::uint32_t object = hits.objects[i];
+                        if (object == HitQueue::no_hit) {
+                            keys[i] = std::numeric_limits<std::uint32_t>::max();
+                            return;
+                        }
+                        std::uint32_t material = visit([](const auto& object) { return object.material; }, data.objects[object]);
+                        keys[i] = (static_cast<std::uint32_t>(data.objects[object].index()) << 28) | (material & 0x0fffffff);
+                    }
+                ).wait();
+                this->queue_sorter.sort(count);
+                order = this->queue_sorter.order.data();
+            }
+            // Shadow: whether anything lies between every hit and the light.
+            this->q.parallel_for(
+                { count },
+                [data, order, paths = current->get_data(), hits = this->hits.get_data()](std::size_t k) {
+                    std::size_t i = order != nullptr ? order[k] : k;
+                    if (hits.objects[i] == HitQueue::no_hit) { return; }
+                    Collision collision = Renderer::get_collision(paths.get_ray(i), data.objects[hits.objects[i]], hits.get_hit(i));
+                    auto [shadow_ray, distance_to_light] = Renderer::get_shadow_ray(data, collision);
+                    hits.occluded[i] = Renderer::get_nearest_collision(data, shadow_ray, distance_to_light, true).has_value();
+                }
+            ).wait();
+            // Shade: add every surface's color to its pixel and queue the reflected or transmitted rays.
+            // Appending to the next queue compacts away the paths that ended.
+            next->count[0] = 0;
+            this->q.parallel_for(
+                { count },
+                [data, order, paths = current->get_data(), next_paths = next->get_data(), hits = this->hits.get_data()](std::size_t k) {
+                    std::size_t i = order != nullptr ? order[k] : k;
+                    Ray ray = paths.get_ray(i);
+                    std::uint32_t pixel = paths.pixels[i];
+                    Vector3 throughput = paths.throughputs[i];
+                    std::uint32_t depth = paths.depths[i];
+                    bool hit = hits.objects[i] != HitQueue::no_hit;
+                    if (auto emitted = Renderer::get_emitted_light(data, ray, hit ? hits.distances[i] : std::numeric_limits<Real>::infinity())) {
+                        data.pixels[pixel] += throughput.cwiseProduct(*emitted);
+                        return;
+                    }
+                    // If the ray hasn't hit anything, it should display the environment.
+                    if (!hit) {
+                        data.pixels[pixel] += throughput.cwiseProduct(data.environment->get_radiance(ray.direction));
+                        return;
+                    }
+                    Collision collision = Renderer::get_collision(ray, data.objects[hits.objects[i]], hits.get_hit(i));
+                    Vector3 color = Renderer::get_surface_color(data, collision, hits.occluded[i]);
+                    Optional<Tuple<Ray, Real>> secondary;
+                    if (depth <= 5) { secondary = Renderer::get_secondary_ray(data, ray, collision); } // TODO: Make max depth configurable.
+                    if (!secondary) {
+                        data.pixels[pixel] += throughput.cwiseProduct(color);
+                        return;
+                    }
+                    auto [secondary_ray, weight] = *secondary;
+                    data.pixels[pixel] += (1 - weight) * throughput.cwiseProduct(color);
+                    next_paths.push(secondary_ray, pixel, weight * throughput, depth + 1);
+                }
+            ).wait();
+            // Optionally order the next bounce's rays by direction octant and origin so neighbouring work items traverse the same nodes.
+            // Sorting gathers the rays back into the current queue, which is free again.
+            if (this->sort_rays && next->size() > 1 && data.bvh_node_count > 0) {
+                std::size_t next_count = next->size();
+                this->q.parallel_for(
+                    { next_count },
+                    [scene_bounds = data.bvh_nodes[0].bounds, paths = next->get_data(), keys = this->queue_sorter.keys.data()](std::size_t i) {
+                        keys[i] = get_ray_sort_key(paths.origins[i], paths.directions[i], scene_bounds);
+                    }
+                ).wait();
+                this->queue_sorter.sort(next_count);
+                current->gather(this->q, next->get_data(), this->queue_sorter.order.data(), next_count);
+            } else {
+                std::swap(current, next);
+            }
+        }
+    }
+
+    /// @param region The pixels to draw, in packets of tile_width by tile_height.
+    template <std::size_t size>
+    void draw_packets(const DeviceData<Object>& data, const Tile& region, std::size_t tile_width, std::size_t tile_height) {
+        for (std::size_t tile_y = region.y; tile_y < region.y + region.height; tile_y += tile_height) {
+            for (std::size_t tile_x = region.x; tile_x < region.x + region.width; tile_x += tile_width) {
+                Array<std::uint32_t, size> ray_indices;
+                std::size_t count = this->get_tile_rays(region, tile_x, tile_y, tile_width, tile_height, ray_indices.data());
+                Array<const Object*, size> nearest_objects{};
+                Array<Hit, size> nearest_hits;
+                RayPacket<size> packet{ data.rays, ray_indices.data(), count };
+                traverse_bvh_packet(data.bvh_nodes, data.bvh_node_count, data.bvh_indices, packet, [&](std::uint32_t i, const RealVector<size>& active) {
+                    return Renderer::intersect_packet(data.objects[i], packet, active, nearest_objects, nearest_hits);
+                });
+                // Reflection and transmission continue one ray at a time.
+                for (std::size_t lane = 0; lane < count; ++lane) {
+                    const Ray& ray = data.rays[ray_indices[lane]];
+                    Optional<Collision> collision;
+                    if (nearest_objects[lane] != nullptr) {
+                        collision = Renderer::get_collision(ray, *nearest_objects[lane], nearest_hits[lane]);
+                    }
+                    data.pixels[ray_indices[lane]] = Renderer::illuminate(data, ray, collision);
+                }
+            }
+        }
+    }
+
+    /// @brief Intersects an object with the lanes of a packet that reached its leaf, recording closer hits.
+    /// Objects with a packet intersection test are tested in all lanes at once, others one lane at a time.
+    /// @return Whether any lane got closer.
+    template <std::size_t size>
+    static bool intersect_packet(
+        const Object& object_variant,
+        RayPacket<size>& packet,
+        const RealVector<size>& active,
+        Array<const Object*, size>& nearest_objects,
+        Array<Hit, size>& nearest_hits
     ) {
-        Real y = ray.origin[1];
-        if (y < 0) {}
-        // This is what we'll return.
-        Optional<Tuple<const Object*, Vector3, Vector3>> result{};
-        // Preset the distance the ray has traveled to a maximum.
-        Real ray_distance = maximum_distance;
-        // Iterate through each object.
-        for (std::size_t i = 0; i < data.object_count; ++i) {
-            const Object& object_variant = data.objects[i];
-            visit([&](const auto& object) {
-                // Check if the object will intersect with the path of the ray.
-                if (auto success = object.intersects(ray)) {
-                    auto& [position, normal] = *success;
-                    // Check if we're closer than the previous collision.
-                    Real distance = (ray.origin - position).norm();
-                    if (distance > ray_distance) {
-                        return; // continue;
+        bool closer = false;
+        auto record = [&](std::size_t lane, const Hit& hit) {
+            // Check if we're closer than the previous collision.
+            if (hit.distance > packet.maximum_distance[lane]) { return; }
+            nearest_objects[lane] = &object_variant;
+            nearest_hits[lane] = hit;
+            packet.maximum_distance[lane] = hit.distance;
+            closer = true;
+        };
+        visit([&](const auto& object) {
+            if constexpr (requires { object.intersects(packet); }) {
+                HitPacket<size> hits = object.intersects(packet);
+                for (std::size_t lane = 0; lane < packet.count; ++lane) {
+                    if (active[lane] == std::numeric_limits<Real>::infinity() || hits.distance[lane] == std::numeric_limits<Real>::infinity()) { continue; }
+                    record(lane, { .distance = hits.distance[lane], .barycentric = { hits.barycentric[0][lane], hits.barycentric[1][lane], hits.barycentric[2][lane] } });
+                }
+            } else {
+                for (std::size_t lane = 0; lane < packet.count; ++lane) {
+                    if (active[lane] == std::numeric_limits<Real>::infinity()) { continue; }
+                    if (Optional<Hit> hit = object.intersects(*packet.rays[lane])) { record(lane, *hit); }
+                }
+            }
+        }, object_variant);
+        return closer;
+    }
+
+    /// @brief Gathers the indices of the primary rays of a tile, clipped to a region of the frame.
+    /// @return The number of rays.
+    std::size_t get_tile_rays(const Tile& region, std::size_t tile_x, std::size_t tile_y, std::size_t tile_width, std::size_t tile_height, std::uint32_t* ray_indices) const {
+        std::size_t count = 0;
+        std::size_t end_x = std::min<std::size_t>(region.x + region.width, this->frame_buffer.width);
+        std::size_t end_y = std::min<std::size_t>(region.y + region.height, this->frame_buffer.height);
+        for (std::size_t y = tile_y; y < std::min(tile_y + tile_height, end_y); ++y) {
+            for (std::size_t x = tile_x; x < std::min(tile_x + tile_width, end_x); ++x) {
+                ray_indices[count++] = static_cast<std::uint32_t>(y * this->frame_buffer.width + x);
+            }
+        }
+        return count;
+    }
+
+    /// @param ray_indices The primary rays to trace, by pixel.
+    void draw_stream(const DeviceData<Object>& data, std::vector<std::uint32_t> ray_indices) {
+        // Results are kept by pixel.
+        std::size_t ray_count = this->frame_buffer.width * this->frame_buffer.height;
+        std::vector<Real> nearest_distances(ray_count, std::numeric_limits<Real>::infinity());
+        std::vector<const Object*> nearest_objects(ray_count, nullptr);
+        std::vector<Hit> nearest_hits(ray_count);
+        traverse_bvh_stream(
+            data.bvh_nodes, data.bvh_node_count, data.bvh_indices,
+            data.rays, ray_indices.data(), ray_indices.size(), nearest_distances.data(),
+            [&](std::uint32_t r, std::uint32_t i) -> Optional<Real> {
+                const Object& object_variant = data.objects[i];
+                Optional<Hit> hit = visit([&](const auto& object) { return object.intersects(data.rays[r]); }, object_variant);
+                if (!hit || hit->distance > nearest_distances[r]) {
+                    return {};
+                }
+                nearest_objects[r] = &object_variant;
+                nearest_hits[r] = *hit;
+                return hit->distance;
+            }
+        );
+        for (std::uint32_t i : ray_indices) {
+            Optional<Collision> collision;
+            if (nearest_objects[i] != nullptr) {
+                collision = Renderer::get_collision(data.rays[i], *nearest_objects[i], nearest_hits[i]);
+            }
+            data.pixels[i] = Renderer::illuminate(data, data.rays[i], collision);
+        }
+    }
+
+    /// @brief The ray from a hit towards the point light, and the distance to the light (0 without a point light, so nothing occludes it).
+    static Tuple<Ray, Real> get_shadow_ray(const DeviceData<Object>& data, const Collision& collision) {
+        auto& [object, position, normal, hit] = collision;
+        Vector3 offset_position = position + (0.001 * normal); // TODO: Define epsilon.
+        const Light* light = Renderer::get_point_light(data);
+        if (light == nullptr) {
+            return { Ray{ offset_position, normal }, 0 };
+        }
+        Vector3 shadow_ray_direction = (light->camera_position - offset_position);
+        Real distance_to_light = shadow_ray_direction.norm();
+        return { Ray{ offset_position, shadow_ray_direction }, distance_to_light };
+    }
+
+    /// @brief Color of the surface at a hit, lit directly by the point light unless it is occluded, and by the lights with area and the environment.
+    static Vector3 get_surface_color(const DeviceData<Object>& data, const Collision& collision, bool occluded) {
+        auto& [object, position, normal, hit] = collision;
+        const Light* point_light = Renderer::get_point_light(data);
+        bool area_lights = Renderer::has_area_lights(data);
+        if ((occluded || point_light == nullptr) && !area_lights) {
+            // This pixel is in shadow.
+            return { 0, 0, 0 };
+        }
+        // Get UV from the hit's barycentric coordinates, and the width of the pixel's footprint in UV units from a ray cone (Akenine-Möller et al. 2019).
+        // Cones are only traced from the camera, so hits of reflected and transmitted rays get the footprint they would have if seen directly.
+        Real cone_width = data.pixel_spread_angle * position.norm();
+        Real cosine = std::max(std::abs(normal.dot(position.normalized())), 0.01_r);
+        auto [uv, uv_footprint] = visit([&](const auto& object) -> Tuple<Vector2, Real> {
+            if constexpr (requires { object.uv; }) {
+                return { object.interpolate(hit.barycentric, object.uv), cone_width / cosine * object.get_uv_density() };
+            }
+            return { Vector2{ 0, 0 }, 0 };
+        }, *object);
+        MaterialInfo material_info{
+            .position = position, .normal = normal, .barycentric = hit.barycentric, .uv = uv, .uv_footprint = uv_footprint, .textures = data.textures,
+            .light_position = point_light != nullptr ? point_light->camera_position : Vector3{ 0, 0, 0 },
+            .light_color = point_light != nullptr ? point_light->color : Vector3{ 0, 0, 0 }
+        };
+        const Material& material = Renderer::get_material(data, *object);
+        Vector3 color{ 0, 0, 0 };
+        if (point_light != nullptr && !occluded) {
+            color = Shaders::shade(material_info, material);
+        }
+        if (area_lights) {
+            color += Renderer::get_area_light_color(data, material_info, material);
+        }
+        return color;
+    }
+
+    /// @brief The light the shaders are given: the first point light.
+    static const Light* get_point_light(const DeviceData<Object>& data) { // TODO: Allow more than one light.
+        for (std::size_t i = 0; i < data.light_count; ++i) {
+            if (!data.lights[i].has_area()) {
+                return &data.lights[i];
+            }
+        }
+        return nullptr;
+    }
+
+    /// @brief Whether any light with area, including the environment, lights the scene.
+    static bool has_area_lights(const DeviceData<Object>& data) {
+        if (data.environment->emitting) {
+            return true;
+        }
+        for (std::size_t i = 0; i < data.light_count; ++i) {
+            if (data.lights[i].has_area()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// @brief The radiance of the nearest light with area a ray hits before a distance.
+    static Optional<Vector3> get_emitted_light(const DeviceData<Object>& data, const Ray& ray, Real maximum_distance) {
+        if (auto nearest = Renderer::get_nearest_area_light(data, ray, maximum_distance)) {
+            auto [light, distance] = *nearest;
+            return light->color;
+        }
+        return {};
+    }
+
+    static Optional<Tuple<const Light*, Real>> get_nearest_area_light(const DeviceData<Object>& data, const Ray& ray, Real maximum_distance) {
+        const Light* nearest_light = nullptr;
+        for (std::size_t i = 0; i < data.light_count; ++i) {
+            if (auto distance = data.lights[i].intersects(ray); distance && *distance < maximum_distance) {
+                nearest_light = &data.lights[i];
+                maximum_distance = *distance;
+            }
+        }
+        if (nearest_light == nullptr) {
+            return {};
+        }
+        return { { nearest_light, maximum_distance } };
+    }
+
+    /// @brief Direct light from the lights with area and the environment at a hit, shading with the material's Phong terms as a BRDF.
+    /// Each of the light_samples samples draws a point on every light and a direction from the environment, a direction from the BRDF, or both, weighting the two by multiple importance sampling.
+    static Vector3 get_area_light_color(const DeviceData<Object>& data, const MaterialInfo& info, const Material& material) {
+        if (data.light_samples == 0) {
+            return { 0, 0, 0 };
+        }
+        shader::PhongBRDF brdf{ info, material };
+        const EnvironmentData& environment = *data.environment;
+        Vector3 origin = info.position + (0.001 * info.normal); // TODO: Define epsilon.
+        Random random{ sampling::hash(info.position, data.frame_index) };
+        bool multiple_importance = data.light_sampling == LightSampling::multiple_importance;
+        // Whether nothing blocks a ray before it reaches a light.
+        auto visible = [&](const Ray& ray, Real distance) {
+            return !Renderer::get_nearest_collision(data, ray, distance * (1 - 1e-3_r), true).has_value(); // TODO: Define epsilon.
+        };
+        Vector3 color{ 0, 0, 0 };
+        for (std::size_t s = 0; s < data.light_samples; ++s) {
+            if (data.light_sampling == LightSampling::light || multiple_importance) {
+                for (std::size_t i = 0; i < data.light_count; ++i) {
+                    const Light& light = data.lights[i];
+                    if (!light.has_area()) { continue; }
+                    Optional<Light::Sample> sample = light.sample(origin, random.uniform2());
+                    if (!sample) { continue; }
+                    Vector3 f = brdf.evaluate(sample->direction);
+                    if (f.isZero() || !visible(Ray{ origin, sample->direction }, sample->distance)) { continue; }
+                    Real weight = multiple_importance ? sampling::power_heuristic(sample->pdf, brdf.get_pdf(sample->direction)) : 1;
+                    color += (weight * info.normal.dot(sample->direction) / sample->pdf) * f.cwiseProduct(light.color);
+                }
+                if (environment.emitting) {
+                    if (auto sample = environment.sample(random.uniform2())) {
+                        auto [direction, pdf] = *sample;
+                        Vector3 f = brdf.evaluate(direction);
+                        if (!f.isZero() && visible(Ray{ origin, direction }, std::numeric_limits<Real>::infinity())) {
+                            Real weight = multiple_importance ? sampling::power_heuristic(pdf, brdf.get_pdf(direction)) : 1;
+                            color += (weight * info.normal.dot(direction) / pdf) * f.cwiseProduct(environment.get_radiance(direction));
+                        }
                     }
-                    // Update the ray distance.
-                    ray_distance = distance;
-                    // Update the object pointer.
-                    result = { Tuple<const Object*, Vector3, Vector3>{ &object_variant, std::move(position), std::move(normal) } };
                 }
-            }, object_variant);
-        }
-        // Return the resultant nearest object.
-        return result;
-    }
-
-    static Vector3 shader_hack(const Object& object, const MaterialInfo& info) {
-        return visit([&](const auto& object) -> Vector3 {
-            if constexpr (std::is_same_v<decltype(object), const Sphere&>) {
-                return shader::phong(info, (info.normal + Vector3{ 1, 1, 1 }) / 2, Vector3{ 1, 1, 1 }, 0.2, 0.4, 0.4, 10);
-            }
-            if constexpr (std::is_same_v<decltype(object), const UVTriangle&>) {
-                Vector3 cheque_color;
-                Vector3 color_a{ 1, 0, 0 };
-                Vector3 color_b{ 1, 1, 0 };
-                Vector2 check_count{ 30, 30 };
-                // Get barycentric coordinate point.
-                Vector3 lambda = object.get_barycentric_coordinate(info.position);
-                // Get UV from barycentric coordinate point.
-                Vector2 uv = object.get_interpolated_attribute(info.position, object.uv);
-                uv = uv.cwiseProduct(check_count);
-                if (static_cast<std::size_t>(uv[0]) % 2 == static_cast<std::size_t>(uv[1]) % 2) {
-                    cheque_color = color_a;
+            }
+            if (data.light_sampling != LightSampling::light) {
+                Vector3 direction;
+                Real pdf;
+                if (data.light_sampling == LightSampling::uniform) {
+                    direction = sampling::sample_uniform_hemisphere(info.normal, random.uniform2());
+                    pdf = 1 / (2 * std::numbers::pi_v<Real>);
+                } else if (auto sample = brdf.sample(random.uniform2())) {
+                    direction = get<0>(*sample);
+                    pdf = get<1>(*sample);
+                } else {
+                    continue;
+                }
+                Ray ray{ origin, direction };
+                Vector3 radiance;
+                Real light_pdf;
+                if (auto nearest = Renderer::get_nearest_area_light(data, ray, std::numeric_limits<Real>::infinity())) {
+                    auto [light, distance] = *nearest;
+                    if (!visible(ray, distance)) { continue; }
+                    radiance = light->color;
+                    light_pdf = light->get_pdf(origin, direction, distance);
+                } else if (environment.emitting && visible(ray, std::numeric_limits<Real>::infinity())) {
+                    // The ray escapes the scene.
+                    radiance = environment.get_radiance(direction);
+                    light_pdf = environment.get_pdf(direction);
                 } else {
-                    cheque_color = color_b;
+                    continue;
                 }
-                // Run phong.
-                return shader::phong(info, cheque_color, Vector3{1, 1, 1}, 0.2, 0.4, 0.4, 10);
+                Real weight = multiple_importance ? sampling::power_heuristic(pdf, light_pdf) : 1;
+                color += (weight * info.normal.dot(direction) / pdf) * brdf.evaluate(direction).cwiseProduct(radiance);
+            }
+        }
+        return color / static_cast<Real>(data.light_samples);
+    }
+
+    /// @brief The reflected or transmitted ray leaving a hit, if its material has one.
+    /// @return The ray and the weight of its color against the surface color.
+    static Optional<Tuple<Ray, Real>> get_secondary_ray(const DeviceData<Object>& data, const Ray& ray, const Collision& collision) {
+        auto [object, position, normal, hit] = collision;
+        const Material& material = Renderer::get_material(data, *object);
+        Real reflection_constant = material.reflection_constant;
+        Real transmission_constant = material.transmission_constant;
+        Real medium_index = material.medium_index;
+        if (reflection_constant > 0) {
+            // Perform reflection.
+            Ray reflection_ray = {
+                position + (0.001 * normal), // TODO: Define epsilon.
+                ray.direction - 2 * (ray.direction.dot(normal)) * normal
+            };
+            return { { reflection_ray, reflection_constant } };
+        }
+        if (transmission_constant > 0) {
+            // Perform transmission.
+            Real eta = 1 / medium_index;
+            Vector3 ray_direction = ray.direction;
+            if (normal.dot(-ray_direction) < 0) {
+                normal = -normal;
+                eta = 1.0 / eta;
             }
-            if constexpr (std::is_same_v<decltype(object), const PhongTriangle&>) {
-                return shader::phong(info, (info.normal + Vector3{ 1, 1, 1 }) / 2, Vector3{ 1, 1, 1 }, 0.2, 0.4, 0.4, 10);
+            Real cos_theta_i = -normal.dot(ray_direction);
+            Real sin_theta_t_squared = eta * eta * (1.0 - cos_theta_i * cos_theta_i);
+            Real cos_theta_t = std::sqrt(1.0 - sin_theta_t_squared);
+            if (sin_theta_t_squared > 1.0) {
+                // Total internal reflection
+                Ray total_internal_reflection_ray = {
+                    position + (0.001 * normal), // TODO: Define epsilon.
+                    ray_direction - 2 * (ray_direction.dot(normal)) * normal
+                };
+                return { { total_internal_reflection_ray, transmission_constant } };
             }
-            return { 1, 0, 1 }; // Debug failure color.
-        }, object);
+            Ray transmission_ray = {
+                position - (0.001 * normal), // TODO: Define epsilon.
+                eta * ray_direction + (eta * cos_theta_i - cos_theta_t) * normal
+            };
+            return { { transmission_ray, transmission_constant } };
+        }
+        return {};
+    }
+
+    /// @brief Reconstructs the hit position and normal of a ray's closest hit.
+    static Collision get_collision(const Ray& ray, const Object& object, const Hit& hit) {
+        Vector3 position = ray.origin + hit.distance * ray.direction;
+        Vector3 normal = visit([&](const auto& object) { return object.get_normal(position, hit); }, object);
+        return { &object, position, normal, hit };
+    }
+
+    /// @brief Finds the closest object along the ray.
+    /// @return The object, the hit position and normal (reconstructed once for the closest hit only), and the hit itself.
+    static Optional<Collision> get_nearest_collision(
+        const DeviceData<Object>& data,
+        const Ray& ray,
+        Real maximum_distance = std::numeric_limits<Real>::infinity(),
+        bool any_hit = false
+    ) {
+        // The closest object so far and where the ray hit it.
+        const Object* nearest_object = nullptr;
+        Hit nearest_hit{ .distance = maximum_distance };
+        // Walk the BVH, testing the objects in every leaf the ray reaches.
+        BVH::traverse(data, ray, nearest_hit.distance, [&](std::uint32_t i) -> Optional<Real> {
+            const Object& object_variant = data.objects[i];
+            // Check if the object will intersect with the path of the ray.
+            Optional<Hit> hit = visit([&](const auto& object) { return object.intersects(ray); }, object_variant);
+            // Check if we're closer than the previous collision.
+            if (!hit || hit->distance > nearest_hit.distance) {
+                return {};
+            }
+            nearest_object = &object_variant;
+            nearest_hit = *hit;
+            return hit->distance;
+        }, any_hit);
+        if (nearest_object == nullptr) {
+            return {};
+        }
+        // Reconstruct the hit attributes.
+        return Renderer::get_collision(ray, *nearest_object, nearest_hit);
+    }
+
+    /// @brief The material an object refers to.
+    static const Material& get_material(const DeviceData<Object>& data, const Object& object) {
+        return data.materials[visit([](const auto& object) { return object.material; }, object)];
     }
 
 public:
+    /// @brief Adds a material to the table.
+    /// @return The index objects refer to it by.
+    std::uint32_t add_material(const Material& material) {
+        this->materials.push_back(material);
+        return static_cast<std::uint32_t>(this->materials.size() - 1);
+    }
+
+    /// @brief Times every BVH builder on the current scene and prints their throughput.
+    void benchmark_bvh_builders(std::size_t repetitions = 10) {
+        this->obtain_camera_coordinates();
+        auto benchmark = [&](const char* name, BVH::Info info) {
+            Real total = 0;
+            for (std::size_t i = 0; i < repetitions; ++i) {
+                this->bvh.build(this->objects.data(), this->objects.size(), info);
+                total += this->bvh.build_time;
+            }
+            Real average = total / repetitions;
+            std::cout << "  " << name << ": " << average << " seconds per build ("
+                << this->objects.size() / average << " primitives/second, " << this->bvh.nodes.size() << " nodes, "
+                << this->bvh.indices.size() << " references, SAH cost " << this->bvh.get_sah_cost() << ")" << std::endl;
+        };
+        std::cout << "BVH builder benchmark (" << this->objects.size() << " primitives, " << repetitions << " repetitions):" << std::endl;
+        benchmark("SAH", { .builder = BVH::Builder::sah });
+        benchmark("SBVH", { .builder = BVH::Builder::sbvh });
+        benchmark("LBVH (30-bit Morton codes)", { .builder = BVH::Builder::lbvh, .morton_precision = MortonPrecision::bits_30 });
+        benchmark("LBVH (63-bit Morton codes)", { .builder = BVH::Builder::lbvh, .morton_precision = MortonPrecision::bits_63 });
+    }
+
+    /// @brief Traces the camera's primary rays through every BVH node layout and prints memory footprint and rays/second.
+    void benchmark_bvh_layouts(std::size_t repetitions = 10) {
+        this->obtain_camera_coordinates();
+        std::size_t ray_count = this->frame_buffer.width * this->frame_buffer.height;
+        Shared<Real, SharedAllocator<Real>> distances{ ray_count, SharedAllocator<Real>{ this->q } };
+        auto benchmark = [&](const char* name, BVH::Info info) {
+            this->bvh.build(this->objects.data(), this->objects.size(), info);
+            auto start = std::chrono::high_resolution_clock::now();
+            for (std::size_t i = 0; i < repetitions; ++i) {
+                this->q.parallel_for(
+                    { ray_count },
+                    [data = this->get_device_data(), distances = distances.data()](std::size_t i) {
+                        Real distance = std::numeric_limits<Real>::infinity();
+                        if (auto success = Renderer::get_nearest_collision(data, data.rays[i])) {
+                            auto& [object, position, normal, hit] = *success;
+                            distance = hit.distance;
+                        }
+                        distances[i] = distance;
+                    }
+                ).wait();
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            Real seconds = std::chrono::duration<Real>{ end - start }.count();
+            std::cout << "  " << name << ": " << this->bvh.get_memory_footprint() / (1024.0 * 1024.0) << " MiB, "
+                << ray_count * repetitions / seconds << " rays/second" << std::endl;
+        };
+        BVH::Info info = this->bvh.info;
+        std::cout << "BVH layout benchmark (" << this->objects.size() << " primitives, " << ray_count << " primary rays):" << std::endl;
+        benchmark("BVH2", { .builder = info.builder, .morton_precision = info.morton_precision, .width = 2 });
+        benchmark("BVH4", { .builder = info.builder, .morton_precision = info.morton_precision, .width = 4 });
+        benchmark("BVH4 (compressed)", { .builder = info.builder, .morton_precision = info.morton_precision, .width = 4, .compressed = true });
+        benchmark("BVH8", { .builder = info.builder, .morton_precision = info.morton_precision, .width = 8 });
+        benchmark("BVH8 (compressed)", { .builder = info.builder, .morton_precision = info.morton_precision, .width = 8, .compressed = true });
+        this->bvh.build(this->objects.data(), this->objects.size());
+    }
+
+    /// @brief Times finding the closest hit of every primary ray with each traversal and prints rays/second.
+    void benchmark_primary_traversal(std::size_t repetitions = 10) {
+        this->obtain_camera_coordinates();
+        this->bvh.build(this->objects.data(), this->objects.size());
+        // Only the closest hits are found, shading is left out.
+        auto data = this->get_device_data();
+        std::size_t ray_count = this->frame_buffer.width * this->frame_buffer.height;
+        std::vector<Real> distances(ray_count);
+        auto benchmark = [&](const char* name, auto&& trace) {
+            auto start = std::chrono::high_resolution_clock::now();
+            for (std::size_t i = 0; i < repetitions; ++i) {
+                std::fill(distances.begin(), distances.end(), std::numeric_limits<Real>::infinity());
+                trace();
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            Real seconds = std::chrono::duration<Real>{ end - start }.count();
+            std::cout << "  " << name << ": " << ray_count * repetitions / seconds << " rays/second" << std::endl;
+        };
+        // Closest hit distance of one ray against one object.
+        auto intersect = [&](const Ray& ray, std::uint32_t i, Real maximum_distance) -> Optional<Real> {
+            Optional<Hit> hit = visit([&](const auto& object) { return object.intersects(ray); }, data.objects[i]);
+            if (!hit || hit->distance > maximum_distance) {
+                return {};
+            }
+            return hit->distance;
+        };
+        auto packets = [&]<std::size_t size>(std::size_t tile_width, std::size_t tile_height) {
+            for (std::size_t tile_y = 0; tile_y < this->frame_buffer.height; tile_y += tile_height) {
+                for (std::size_t tile_x = 0; tile_x < this->frame_buffer.width; tile_x += tile_width) {
+                    Array<std::uint32_t, size> ray_indices;
+                    std::size_t count = this->get_tile_rays(this->get_frame_tile(), tile_x, tile_y, tile_width, tile_height, ray_indices.data());
+                    Array<const Object*, size> nearest_objects{};
+                    Array<Hit, size> nearest_hits;
+                    RayPacket<size> packet{ data.rays, ray_indices.data(), count };
+                    traverse_bvh_packet(data.bvh_nodes, data.bvh_node_count, data.bvh_indices, packet, [&](std::uint32_t i, const RealVector<size>& active) {
+                        return Renderer::intersect_packet(data.objects[i], packet, active, nearest_objects, nearest_hits);
+                    });
+                    for (std::size_t lane = 0; lane < count; ++lane) {
+                        distances[ray_indices[lane]] = packet.maximum_distance[lane];
+                    }
+                }
+            }
+        };
+        std::cout << "Primary ray traversal benchmark (" << this->objects.size() << " primitives, " << ray_count << " primary rays):" << std::endl;
+        benchmark("Single rays", [&]() {
+            for (std::size_t i = 0; i < ray_count; ++i) {
+                traverse_bvh(data.bvh_nodes, data.bvh_node_count, data.bvh_indices, data.rays[i], distances[i], [&](std::uint32_t j) {
+                    return intersect(data.rays[i], j, distances[i]);
+                });
+            }
+        });
+        benchmark("Packets of 4 (2x2 tiles)", [&]() { packets.template operator()<4>(2, 2); });
+        benchmark("Packets of 8 (4x2 tiles)", [&]() { packets.template operator()<8>(4, 2); });
+        benchmark("Packets of 16 (4x4 tiles)", [&]() { packets.template operator()<16>(4, 4); });
+        benchmark("Stream", [&]() {
+            std::vector<std::uint32_t> ray_indices(ray_count);
+            std::iota(ray_indices.begin(), ray_indices.end(), 0);
+            traverse_bvh_stream(data.bvh_nodes, data.bvh_node_count, data.bvh_indices, data.rays, ray_indices.data(), ray_count, distances.data(), [&](std::uint32_t r, std::uint32_t i) {
+                return intersect(data.rays[r], i, distances[r]);
+            });
+        });
+    }
+
+    /// @brief Times the wavefront integrator with and without the sorting passes for growing numbers of paths and prints the speedups.
+    /// Sorting costs a fixed number of kernel launches plus time linear in the paths, so it only pays off past some queue size; this shows where.
+    void benchmark_wavefront_sorting(std::size_t repetitions = 10) {
+        this->obtain_camera_coordinates();
+        this->bvh.build(this->objects.data(), this->objects.size());
+        auto data = this->get_device_data();
+        bool sort_hits = this->sort_hits;
+        bool sort_rays = this->sort_rays;
+        auto benchmark = [&](bool hits, bool rays, std::size_t path_count) {
+            this->sort_hits = hits;
+            this->sort_rays = rays;
+            auto start = std::chrono::high_resolution_clock::now();
+            for (std::size_t i = 0; i < repetitions; ++i) {
+                this->draw_wavefront(data, path_count);
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            return std::chrono::duration<Real>{ end - start }.count() / repetitions;
+        };
+        std::size_t pixel_count = this->frame_buffer.width * this->frame_buffer.height;
+        std::cout << "Wavefront sorting benchmark (" << this->objects.size() << " primitives, seconds per frame and speedup over no sorting):" << std::endl;
+        for (std::size_t divisor = 256; divisor >= 1; divisor /= 4) {
+            std::size_t path_count = std::max<std::size_t>(pixel_count / divisor, 1);
+            Real unsorted = benchmark(false, false, path_count);
+            Real hits_sorted = benchmark(true, false, path_count);
+            Real rays_sorted = benchmark(false, true, path_count);
+            Real both_sorted = benchmark(true, true, path_count);
+            std::cout << "  " << path_count << " paths: unsorted " << unsorted
+                << ", hits sorted " << hits_sorted << " (" << unsorted / hits_sorted << "x)"
+                << ", rays sorted " << rays_sorted << " (" << unsorted / rays_sorted << "x)"
+                << ", both " << both_sorted << " (" << unsorted / both_sorted << "x)" << std::endl;
+        }
+        this->sort_hits = sort_hits;
+        this->sort_rays = sort_rays;
+    }
+
+    /// @brief Renders a frame with each texel layout, with and without mip mapping, and prints the bytes of texels each fetched (counting each cache line once).
+    void benchmark_texture_bandwidth() {
+        this->obtain_camera_coordinates();
+        this->bvh.build(this->objects.data(), this->objects.size());
+        TextureLayout layout = this->textures.layout;
+        bool mipmaps = this->textures.mipmaps;
+        bool measure_bandwidth = this->textures.measure_bandwidth;
+        this->textures.measure_bandwidth = true;
+        auto benchmark = [&](TextureLayout layout, bool mipmaps) {
+            this->textures.set_layout(layout);
+            this->textures.mipmaps = mipmaps;
+            auto data = this->get_device_data();
+            this->textures.reset_bytes_fetched();
+            auto start = std::chrono::high_resolution_clock::now();
+            this->draw(data);
+            auto end = std::chrono::high_resolution_clock::now();
+            return Tuple<std::size_t, Real>{ this->textures.get_bytes_fetched(), std::chrono::duration<Real>{ end - start }.count() };
+        };
+        std::cout << "Texture bandwidth benchmark (" << this->textures.textures.size() << " textures, "
+            << this->textures.texels.size() * sizeof(std::uint32_t) << " bytes of texels, bytes fetched per frame):" << std::endl;
+        auto [naive_bytes, naive_seconds] = benchmark(TextureLayout::row_major, false);
+        std::cout << "  Row-major, base level: " << naive_bytes << " (" << naive_seconds << " seconds)" << std::endl;
+        auto print = [&](const char* name, TextureLayout layout, bool mipmaps) {
+            auto [bytes, seconds] = benchmark(layout, mipmaps);
+            std::cout << "  " << name << ": " << bytes << " (" << static_cast<Real>(naive_bytes) / std::max<std::size_t>(bytes, 1) << "x less, " << seconds << " seconds)" << std::endl;
+        };
+        print("Tiled, base level", TextureLayout::tiled, false);
+        print("Row-major, mip mapped", TextureLayout::row_major, true);
+        print("Tiled, mip mapped", TextureLayout::tiled, true);
+        this->textures.set_layout(layout);
+        this->textures.mipmaps = mipmaps;
+        this->textures.measure_bandwidth = measure_bandwidth;
+    }
+
+    /// @brief Makes a mesh glow: every face becomes a triangle light emitting radiance color.
+    void add_mesh_light(const std::vector<Vector3H>& vertices, const std::vector<Array<std::uint32_t, 3>>& faces, const Vector3& color) {
+        for (const auto& face : faces) {
+            this->lights.push_back(Light::triangle(vertices[face[0]], vertices[face[1]], vertices[face[2]], color));
+        }
+    }
+
+    /// @brief Renders the scene's area and environment lighting with each sampling strategy at growing sample counts and prints the RMSE against a reference.
+    void benchmark_light_sampling(std::size_t reference_samples = 256) {
+        this->obtain_camera_coordinates();
+        this->bvh.build(this->objects.data(), this->objects.size());
+        std::size_t light_samples = this->light_samples;
+        LightSampling light_sampling = this->light_sampling;
+        std::size_t pixel_count = this->frame_buffer.width * this->frame_buffer.height;
+        auto render = [&](LightSampling strategy, std::size_t samples) {
+            this->light_samples = samples;
+            this->light_sampling = strategy;
+            this->draw(this->get_device_data());
+            ++this->frame_index;
+            return std::vector<Vector3>(this->frame_buffer.pixels, this->frame_buffer.pixels + pixel_count);
+        };
+        std::vector<Vector3> reference = render(LightSampling::multiple_importance, reference_samples);
+        auto error = [&](const std::vector<Vector3>& image) {
+            Real sum = 0;
+            for (std::size_t i = 0; i < pixel_count; ++i) {
+                sum += (image[i] - reference[i]).squaredNorm();
+            }
+            return std::sqrt(sum / pixel_count);
+        };
+        std::cout << "Light sampling benchmark (RMSE against " << reference_samples << " samples with multiple importance sampling):" << std::endl;
+        for (std::size_t samples = 1; samples <= 64; samples *= 4) {
+            std::cout << "  " << samples << " samples: uniform " << error(render(LightSampling::uniform, samples))
+                << ", light " << error(render(LightSampling::light, samples))
+                << ", BSDF " << error(render(LightSampling::bsdf, samples))
+                << ", multiple importance " << error(render(LightSampling::multiple_importance, samples)) << std::endl;
+        }
+        this->light_samples = light_samples;
+        this->light_sampling = light_sampling;
+    }
+
+    /// @brief Adds count randomly placed and oriented triangles inside a cube, for synthetic stress scenes.
+    void load_random_triangles(std::size_t count, Real scene_size = 10, Real triangle_size = 0.05, std::uint32_t seed = 0) {
+        std::mt19937 generator{ seed };
+        std::uniform_real_distribution<Real> position{ -scene_size / 2, scene_size / 2 };
+        std::uniform_real_distribution<Real> offset{ -triangle_size, triangle_size };
+        this->objects.reserve(this->objects.size() + count);
+        for (std::size_t i = 0; i < count; ++i) {
+            Vector3H center{ position(generator), position(generator), position(generator), 0 };
+            auto vertex = [&]() { return Vector3H{ center.x() + offset(generator), center.y() + offset(generator), center.z() + offset(generator), 1_r }; };
+            this->objects.push_back(PhongTriangle(vertex(), vertex(), vertex()));
+        }
+    }
+
     void load_ply(std::string_view path) {
         happly::PLYData in(std::string{path});
         std::vector<std::array<double, 3>> vertex_positions = in.getVertexPositions();
@@ -0,0 +1,94 @@
+#ifndef GI_BAH8454_SAMPLING
+#define GI_BAH8454_SAMPLING
+
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+
+#include "util.hpp"
+
+/// @brief Small PCG32 generator (O'Neill 2014) that kernels can keep on the stack.
+class Random {
+public:
+	Random(std::uint64_t seed, std::uint64_t stream = 0) : state{ 0 }, increment{ (stream << 1) | 1 } {
+		this->next();
+		this->state += seed;
+		this->next();
+	}
+
+	std::uint32_t next() {
+		std::uint64_t old_state = this->state;
+		this->state = old_state * 6364136223846793005ull + this->increment;
+		std::uint32_t xor_shifted = static_cast<std::uint32_t>(((old_state >> 18) ^ old_state) >> 27);
+		std::uint32_t rotation = static_cast<std::uint32_t>(old_state >> 59);
+		return std::rotr(xor_shifted, static_cast<int>(rotation));
+	}
+
+	/// @brief Uniform in [0, 1).
+	Real uniform() {
+		return std::min(static_cast<Real>(this->next()) * 0x1p-32_r, 1 - std::numeric_limits<Real>::epsilon());
+	}
+
+	Vector2 uniform2() {
+		Real x = this->uniform();
+		return { x, this->uniform() };
+	}
+
+private:
+	std::uint64_t state;
+	std::uint64_t increment;
+};
+
+namespace sampling {
+
+/// @brief Hashes the bits of a position, for seeding generators per shading point.
+inline std::uint64_t hash(const Vector3& position, std::uint32_t salt = 0) {
+	std::uint64_t h = 0xcbf29ce484222325ull ^ salt;
+	for (int i = 0; i < 3; ++i) {
+		h ^= std::bit_cast<std::uint32_t>(position[i]);
+		h *= 0x100000001b3ull;
+		h ^= h >> 29;
+	}
+	return h;
+}
+
+/// @brief Two unit vectors perpendicular to n and each other (Duff et al. 2017).
+inline Tuple<Vector3, Vector3> get_orthonormal_basis(const Vector3& n) {
+	Real sign = std::copysign(1_r, n.z());
+	Real a = -1 / (sign + n.z());
+	Real b = n.x() * n.y() * a;
+	return { Vector3{ 1 + sign * n.x() * n.x() * a, sign * b, -sign * n.x() }, Vector3{ b, sign + n.y() * n.y() * a, -n.y() } };
+}
+
+/// @brief A direction around axis at the given cosine, rotated by 2 pi u.
+inline Vector3 get_direction_around(const Vector3& axis, Real cos_theta, Real u) {
+	auto [tangent, bitangent] = sampling::get_orthonormal_basis(axis);
+	Real sin_theta = std::sqrt(std::max(1 - cos_theta * cos_theta, 0_r));
+	Real phi = 2 * std::numbers::pi_v<Real> * u;
+	return (std::cos(phi) * sin_theta * tangent + std::sin(phi) * sin_theta * bitangent + cos_theta * axis).normalized();
+}
+
+/// @brief Cosine-weighted direction in the hemisphere around n (density cos / pi).
+inline Vector3 sample_cosine_hemisphere(const Vector3& n, const Vector2& u) {
+	return sampling::get_direction_around(n, std::sqrt(1 - u[0]), u[1]);
+}
+
+/// @brief Direction uniform over the hemisphere around n (density 1 / 2 pi).
+inline Vector3 sample_uniform_hemisphere(const Vector3& n, const Vector2& u) {
+	return sampling::get_direction_around(n, u[0], u[1]);
+}
+
+/// @brief Direction uniform over the sphere (density 1 / 4 pi).
+inline Vector3 sample_uniform_sphere(const Vector2& u) {
+	return sampling::get_direction_around(Vector3{ 0, 0, 1 }, 1 - 2 * u[0], u[1]);
+}
+
+/// @brief Weight of a sample drawn with density f against another strategy with density g (Veach 1997).
+inline Real power_heuristic(Real f, Real g) {
+	return f * f / (f * f + g * g);
+}
+
+};
+
+#endif
\ No newline at end of file
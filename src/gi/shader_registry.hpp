@@ -0,0 +1,49 @@
+#ifndef GI_BAH8454_SHADER_REGISTRY
+#define GI_BAH8454_SHADER_REGISTRY
+
+#include <concepts>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include "util.hpp"
+#include "material.hpp"
+
+template <typename T>
+concept Shader = std::is_trivially_copyable_v<T> && std::default_initializable<T> && requires (const T shader, const MaterialInfo& info, const Material& material) {
+	{ shader(info, material) } -> std::convertible_to<Vector3>;
+};
+
+/// @brief The shaders compiled into a renderer, selected per material by Material::shader.
+/// Dispatch is a chain of comparisons against constant indices that the compiler lowers to a switch, so kernels make no indirect calls and shaders that aren't registered are never instantiated.
+template <Shader... Shaders>
+class ShaderRegistry {
+public:
+	static_assert(sizeof...(Shaders) > 0, "At least one shader must be registered.");
+
+	static constexpr std::size_t shader_count = sizeof...(Shaders);
+
+	/// @brief The index materials select a registered shader by.
+	template <Shader S>
+	static constexpr std::uint32_t index = [] {
+		static_assert((std::is_same_v<S, Shaders> || ...), "The shader is not registered.");
+		std::uint32_t i = 0;
+		(void)((std::is_same_v<S, Shaders> ? false : (++i, true)) && ...);
+		return i;
+	}();
+
+	/// @brief Runs the material's shader.  Materials with an unregistered index get their albedo.
+	static Vector3 shade(const MaterialInfo& info, const Material& material) {
+		return ShaderRegistry::shade(info, material, std::index_sequence_for<Shaders...>{});
+	}
+
+private:
+	template <std::size_t... I>
+	static Vector3 shade(const MaterialInfo& info, const Material& material, std::index_sequence<I...>) {
+		Vector3 color = material.albedo;
+		(void)((material.shader == I && (color = Shaders{}(info, material), true)) || ...);
+		return color;
+	}
+};
+
+#endif
\ No newline at end of file
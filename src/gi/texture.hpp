@@ -0,0 +1,522 @@
+#ifndef GI_BAH8454_TEXTURE
+#define GI_BAH8454_TEXTURE
+
+// Include SYCL.
+#include <sycl/sycl.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "util.hpp"
+#include "texture_cache.hpp"
+
+enum class TextureLayout {
+	// Rows of texels one after another, for comparison.
+	row_major,
+	// Tiles of tile_size x tile_size texels, texels inside a tile in Morton order, so a filter footprint usually falls in one or two cache lines.
+	tiled
+};
+
+enum class TextureFilter {
+	// The nearest texel of the nearest mip level.
+	nearest,
+	// Bilinear filtering of the nearest mip level.
+	bilinear,
+	// Bilinear filtering of the two nearest mip levels, blended.
+	trilinear
+};
+
+/// @brief An image in a TextureStore: its mip chain and where each level lives in the store's texels.
+class Texture {
+public:
+	static constexpr std::uint32_t max_level_count = 16;
+
+	std::uint32_t width;
+	std::uint32_t height;
+	std::uint32_t level_count;
+	// Whether texels hold sRGB-encoded colors (decoded through the store's lookup table) rather than linear ones.
+	bool srgb;
+	// Levels before this one are streamed through the texture cache (see TextureStore::open_page_file); the rest live in the store.
+	std::uint32_t first_resident_level;
+	// First texel of each resident level in the store.
+	Array<std::uint32_t, max_level_count> offsets;
+	// First cache page of each streamed level, its pages running row by row.
+	Array<std::uint32_t, max_level_count> first_pages;
+	Array<std::uint32_t, max_level_count> widths;
+	Array<std::uint32_t, max_level_count> heights;
+};
+
+/// @brief Raw pointers to a TextureStore for kernels to sample through.
+class TextureData {
+public:
+	static constexpr std::uint32_t tile_size = 8;
+	// Texels per 64-byte cache line.
+	static constexpr std::uint32_t line_texel_count = 16;
+
+	const Texture* textures;
+	std::size_t texture_count;
+	// RGBA8 texels, red in the lowest byte.
+	const std::uint32_t* texels;
+	// Linear value of each 8-bit sRGB channel value.
+	const Real* srgb_to_linear;
+	TextureLayout layout;
+	TextureFilter filter;
+	bool mipmaps;
+	// One bit per cache line of texels fetched, or nullptr when bandwidth isn't being measured.
+	std::uint32_t* touched_lines;
+	TextureCache::Data cache;
+
+	/// @brief Position of texel (x, y) of a level within the level.
+	static std::uint32_t get_texel_index(TextureLayout layout, std::uint32_t width, std::uint32_t x, std::uint32_t y) {
+		if (layout == TextureLayout::row_major) {
+			return y * width + x;
+		}
+		std::uint32_t tile_columns = (width + tile_size - 1) / tile_size;
+		std::uint32_t tile = (y / tile_size) * tile_columns + x / tile_size;
+		return tile * tile_size * tile_size + TextureData::interleave(x % tile_size, y % tile_size);
+	}
+
+	/// @brief Texels a level takes up, including the padding of partial tiles.
+	static std::uint32_t get_level_size(TextureLayout layout, std::uint32_t width, std::uint32_t height) {
+		if (layout == TextureLayout::row_major) {
+			return width * height;
+		}
+		return ((width + tile_size - 1) / tile_size) * ((height + tile_size - 1) / tile_size) * tile_size * tile_size;
+	}
+
+	/// @brief Filtered linear color of a texture, wrapping around at the edges.
+	/// @param footprint Width of the pixel's footprint on the surface in UV units, choosing the mip level.
+	Vector3 sample(std::uint32_t texture_index, const Vector2& uv, Real footprint) const {
+		const Texture& texture = this->textures[texture_index];
+		Real lod = 0;
+		if (this->mipmaps && footprint > 0) {
+			lod = std::log2(footprint * std::max(texture.width, texture.height));
+			lod = std::clamp(lod, 0_r, static_cast<Real>(texture.level_count - 1));
+		}
+		if (this->filter == TextureFilter::nearest) {
+			std::uint32_t level = this->get_resident_level(texture, static_cast<std::uint32_t>(lod + 0.5_r), uv);
+			return this->fetch(texture, level, TextureData::wrap(uv[0] * texture.widths[level], texture.widths[level]), TextureData::wrap(uv[1] * texture.heights[level], texture.heights[level]));
+		}
+		if (this->filter == TextureFilter::bilinear) {
+			return this->sample_bilinear(texture, this->get_resident_level(texture, static_cast<std::uint32_t>(lod + 0.5_r), uv), uv);
+		}
+		std::uint32_t level = static_cast<std::uint32_t>(lod);
+		std::uint32_t resident_level = this->get_resident_level(texture, level, uv);
+		if (resident_level != level) {
+			return this->sample_bilinear(texture, resident_level, uv);
+		}
+		Real t = lod - level;
+		Vector3 color = this->sample_bilinear(texture, level, uv);
+		if (t > 0 && level + 1 < texture.level_count) {
+			color = (1 - t) * color + t * this->sample_bilinear(texture, level + 1, uv);
+		}
+		return color;
+	}
+
+private:
+	/// @brief Interleaves the bits of x and y (x in the even bits).
+	static std::uint32_t interleave(std::uint32_t x, std::uint32_t y) {
+		std::uint32_t code = 0;
+		for (std::uint32_t bit = 0; (1u << bit) < tile_size; ++bit) {
+			code |= ((x >> bit) & 1) << (2 * bit);
+			code |= ((y >> bit) & 1) << (2 * bit + 1);
+		}
+		return code;
+	}
+
+	static std::uint32_t wrap(Real coordinate, std::uint32_t size) {
+		std::int64_t i = static_cast<std::int64_t>(std::floor(coordinate)) % static_cast<std::int64_t>(size);
+		return static_cast<std::uint32_t>(i < 0 ? i + size : i);
+	}
+
+	Vector3 sample_bilinear(const Texture& texture, std::uint32_t level, const Vector2& uv) const {
+		std::uint32_t width = texture.widths[level];
+		std::uint32_t height = texture.heights[level];
+		// Texel centers sit at half coordinates.
+		Real x = uv[0] * width - 0.5_r;
+		Real y = uv[1] * height - 0.5_r;
+		Real x_floor = std::floor(x);
+		Real y_floor = std::floor(y);
+		Real s = x - x_floor;
+		Real t = y - y_floor;
+		std::uint32_t x0 = TextureData::wrap(x_floor, width);
+		std::uint32_t y0 = TextureData::wrap(y_floor, height);
+		std::uint32_t x1 = x0 + 1 == width ? 0 : x0 + 1;
+		std::uint32_t y1 = y0 + 1 == height ? 0 : y0 + 1;
+		return (1 - t) * ((1 - s) * this->fetch(texture, level, x0, y0) + s * this->fetch(texture, level, x1, y0))
+			+ t * ((1 - s) * this->fetch(texture, level, x0, y1) + s * this->fetch(texture, level, x1, y1));
+	}
+
+	/// @brief The cache page holding texel (x, y) of a streamed level, or nullptr if it isn't resident.
+	const std::uint32_t* get_page(const Texture& texture, std::uint32_t level, std::uint32_t x, std::uint32_t y) const {
+		std::uint32_t page_columns = (texture.widths[level] + TextureCache::page_size - 1) / TextureCache::page_size;
+		return this->cache.get_page(texture.first_pages[level] + (y / TextureCache::page_size) * page_columns + x / TextureCache::page_size);
+	}
+
+	/// @brief The finest level from level up whose page under uv is resident, counting a cache hit if that is level itself.
+	/// Pages missed on the way are requested, so finer levels fill in over the next frames.
+	std::uint32_t get_resident_level(const Texture& texture, std::uint32_t level, const Vector2& uv) const {
+		if (level >= texture.first_resident_level) {
+			return level;
+		}
+		std::uint32_t resident_level = level;
+		while (
+			resident_level < texture.first_resident_level &&
+			this->get_page(
+				texture, resident_level,
+				TextureData::wrap(uv[0] * texture.widths[resident_level], texture.widths[resident_level]),
+				TextureData::wrap(uv[1] * texture.heights[resident_level], texture.heights[resident_level])
+			) == nullptr
+		) {
+			++resident_level;
+		}
+		this->cache.record(resident_level == level);
+		return resident_level;
+	}
+
+	Vector3 fetch(const Texture& texture, std::uint32_t level, std::uint32_t x, std::uint32_t y) const {
+		if (level < texture.first_resident_level) {
+			if (const std::uint32_t* page = this->get_page(texture, level, x, y)) {
+				return this->decode(texture, page[TextureData::get_texel_index(TextureLayout::tiled, TextureCache::page_size, x % TextureCache::page_size, y % TextureCache::page_size)]);
+			}
+			// The filter footprint crosses into a page still in flight: use the first level that is always resident.
+			std::uint32_t shift = texture.first_resident_level - level;
+			level = texture.first_resident_level;
+			x = std::min(x >> shift, texture.widths[level] - 1);
+			y = std::min(y >> shift, texture.heights[level] - 1);
+		}
+		std::uint32_t i = texture.offsets[level] + TextureData::get_texel_index(this->layout, texture.widths[level], x, y);
+		if (this->touched_lines != nullptr) {
+			std::uint32_t line = i / line_texel_count;
+			sycl::atomic_ref<std::uint32_t, sycl::memory_order::relaxed, sycl::memory_scope::device> word{ this->touched_lines[line / 32] };
+			word.fetch_or(1u << (line % 32));
+		}
+		return this->decode(texture, this->texels[i]);
+	}
+
+	Vector3 decode(const Texture& texture, std::uint32_t texel) const {
+		if (texture.srgb) {
+			return { this->srgb_to_linear[texel & 0xff], this->srgb_to_linear[(texel >> 8) & 0xff], this->srgb_to_linear[(texel >> 16) & 0xff] };
+		}
+		return Vector3{
+			static_cast<Real>(texel & 0xff),
+			static_cast<Real>((texel >> 8) & 0xff),
+			static_cast<Real>((texel >> 16) & 0xff)
+		} / 255;
+	}
+};
+
+/// @brief Image textures in shared memory.  Mip chains are built when a texture is added.
+class TextureStore {
+public:
+	class Info {
+	public:
+		TextureLayout layout = TextureLayout::tiled;
+		TextureFilter filter = TextureFilter::trilinear;
+		bool mipmaps = true;
+		// Record which cache lines of texels are fetched (costs an atomic per fetch).
+		bool measure_bandwidth = false;
+		// Only used by textures opened from page files.
+		TextureCache::Info cache;
+	};
+
+	TextureStore(sycl::queue& q, const Info& info) :
+		textures{ SharedAllocator<Texture>{ q } },
+		texels{ SharedAllocator<std::uint32_t>{ q } },
+		srgb_to_linear{ 256, 0, SharedAllocator<Real>{ q } },
+		touched_lines{ SharedAllocator<std::uint32_t>{ q } },
+		layout{ info.layout },
+		filter{ info.filter },
+		mipmaps{ info.mipmaps },
+		measure_bandwidth{ info.measure_bandwidth },
+		cache{ q, info.cache },
+		data{ 1, TextureData{}, SharedAllocator<TextureData>{ q } }
+	{
+		for (std::size_t i = 0; i < 256; ++i) {
+			this->srgb_to_linear[i] = TextureStore::decode_srgb(i / 255_r);
+		}
+	}
+
+	/// @brief Adds an image and its mip chain.
+	/// @param rgba width * height RGBA8 texels, row by row from the top.
+	/// @param srgb Whether the colors are sRGB-encoded (color maps) or linear (data maps).
+	/// @return The index materials refer to the texture by.
+	std::uint32_t add(std::uint32_t width, std::uint32_t height, const std::uint8_t* rgba, bool srgb = true) {
+		Texture texture{ .width = width, .height = height, .level_count = 0, .srgb = srgb, .first_resident_level = 0 };
+		for (const Level& level : this->build_levels(width, height, rgba, srgb)) {
+			this->append_level(texture, level.width, level.height, level.texels.data());
+		}
+		this->textures.push_back(texture);
+		return static_cast<std::uint32_t>(this->textures.size() - 1);
+	}
+
+	/// @brief Writes an image's mip chain to a page file for open_page_file, converting it ahead of time so it can be streamed.
+	/// Levels larger than a page are stored as pages of TextureCache::page_size texels square, tiled like texture levels; the smaller levels follow row by row.
+	void write_page_file(const std::string& path, std::uint32_t width, std::uint32_t height, const std::uint8_t* rgba, bool srgb = true) const {
+		std::vector<Level> levels = this->build_levels(width, height, rgba, srgb);
+		std::uint32_t first_resident_level = 0;
+		while (first_resident_level + 1 < levels.size() && std::max(levels[first_resident_level].width, levels[first_resident_level].height) > TextureCache::page_size) {
+			++first_resident_level;
+		}
+		std::ofstream file{ path, std::ios::binary };
+		Array<std::uint32_t, 6> header{ page_file_magic, width, height, srgb, static_cast<std::uint32_t>(levels.size()), first_resident_level };
+		file.write(reinterpret_cast<const char*>(header.data()), sizeof(header));
+		std::vector<std::uint32_t> page(TextureCache::page_texel_count);
+		for (std::uint32_t l = 0; l < first_resident_level; ++l) {
+			const Level& level = levels[l];
+			for (std::uint32_t page_y = 0; page_y < level.height; page_y += TextureCache::page_size) {
+				for (std::uint32_t page_x = 0; page_x < level.width; page_x += TextureCache::page_size) {
+					std::fill(page.begin(), page.end(), 0);
+					for (std::uint32_t y = page_y; y < std::min(page_y + TextureCache::page_size, level.height); ++y) {
+						for (std::uint32_t x = page_x; x < std::min(page_x + TextureCache::page_size, level.width); ++x) {
+							page[TextureData::get_texel_index(TextureLayout::tiled, TextureCache::page_size, x - page_x, y - page_y)] = level.texels[y * level.width + x];
+						}
+					}
+					file.write(reinterpret_cast<const char*>(page.data()), page.size() * sizeof(std::uint32_t));
+				}
+			}
+		}
+		for (std::uint32_t l = first_resident_level; l < levels.size(); ++l) {
+			file.write(reinterpret_cast<const char*>(levels[l].texels.data()), levels[l].texels.size() * sizeof(std::uint32_t));
+		}
+		if (!file) {
+			throw std::runtime_error{ "Could not write the page file \"" + path + "\"." };
+		}
+	}
+
+	/// @brief Adds a texture from a page file, reading only the levels that fit in a page.  Finer levels are streamed through the cache as they are sampled.
+	std::uint32_t open_page_file(const std::string& path) {
+		std::ifstream file{ path, std::ios::binary };
+		Array<std::uint32_t, 6> header{};
+		file.read(reinterpret_cast<char*>(header.data()), sizeof(header));
+		if (!file || header[0] != page_file_magic || header[1] == 0 || header[2] == 0 || header[4] == 0 || header[4] > Texture::max_level_count || header[5] >= header[4]) {
+			throw std::runtime_error{ "Could not read \"" + path + "\" as a page file." };
+		}
+		Texture texture{ .width = header[1], .height = header[2], .level_count = 0, .srgb = header[3] != 0, .first_resident_level = header[5] };
+		// Streamed levels' pages are stored back to back.
+		std::size_t page_count = 0;
+		std::uint32_t width = texture.width;
+		std::uint32_t height = texture.height;
+		for (std::uint32_t l = 0; l < texture.first_resident_level; ++l) {
+			texture.first_pages[l] = static_cast<std::uint32_t>(page_count);
+			texture.widths[l] = width;
+			texture.heights[l] = height;
+			page_count += static_cast<std::size_t>((width + TextureCache::page_size - 1) / TextureCache::page_size) * ((height + TextureCache::page_size - 1) / TextureCache::page_size);
+			width = std::max(width / 2, 1u);
+			height = std::max(height / 2, 1u);
+		}
+		if (page_count > std::numeric_limits<std::uint32_t>::max()) {
+			throw std::runtime_error{ "The page file \"" + path + "\" has too many pages." };
+		}
+		// Check the whole file is there before registering its pages with the cache.
+		std::size_t size = sizeof(header) + page_count * TextureCache::page_texel_count * sizeof(std::uint32_t);
+		std::uint32_t level_width = width;
+		std::uint32_t level_height = height;
+		for (std::uint32_t l = texture.first_resident_level; l < header[4]; ++l) {
+			size += static_cast<std::size_t>(level_width) * level_height * sizeof(std::uint32_t);
+			level_width = std::max(level_width / 2, 1u);
+			level_height = std::max(level_height / 2, 1u);
+		}
+		file.seekg(0, std::ios::end);
+		std::streamoff file_size = file.tellg();
+		if (file_size < 0 || static_cast<std::size_t>(file_size) < size) {
+			throw std::runtime_error{ "The page file \"" + path + "\" is truncated." };
+		}
+		std::uint32_t first_page = this->cache.add_pages(path, sizeof(header), static_cast<std::uint32_t>(page_count));
+		for (std::uint32_t l = 0; l < texture.first_resident_level; ++l) {
+			texture.first_pages[l] += first_page;
+		}
+		texture.level_count = texture.first_resident_level;
+		file.seekg(sizeof(header) + page_count * TextureCache::page_texel_count * sizeof(std::uint32_t));
+		std::vector<std::uint32_t> texels;
+		for (std::uint32_t l = texture.first_resident_level; l < header[4]; ++l) {
+			texels.resize(static_cast<std::size_t>(width) * height);
+			file.read(reinterpret_cast<char*>(texels.data()), texels.size() * sizeof(std::uint32_t));
+			this->append_level(texture, width, height, texels.data());
+			width = std::max(width / 2, 1u);
+			height = std::max(height / 2, 1u);
+		}
+		if (!file) {
+			throw std::runtime_error{ "The page file \"" + path + "\" is truncated." };
+		}
+		this->textures.push_back(texture);
+		return static_cast<std::uint32_t>(this->textures.size() - 1);
+	}
+
+	/// @brief Adds a binary PPM (P6) image.
+	std::uint32_t load_ppm(const std::string& path, bool srgb = true) {
+		std::ifstream file{ path, std::ios::binary };
+		std::string magic;
+		std::uint32_t width = 0, height = 0, maximum = 0;
+		file >> magic >> width >> height >> maximum;
+		file.get();
+		if (!file || magic != "P6" || maximum != 255) {
+			throw std::runtime_error{ "Could not read \"" + path + "\" as an 8-bit binary PPM." };
+		}
+		std::vector<std::uint8_t> rgb(static_cast<std::size_t>(width) * height * 3);
+		file.read(reinterpret_cast<char*>(rgb.data()), rgb.size());
+		std::vector<std::uint8_t> rgba(static_cast<std::size_t>(width) * height * 4, 255);
+		for (std::size_t i = 0; i < static_cast<std::size_t>(width) * height; ++i) {
+			std::copy_n(&rgb[3 * i], 3, &rgba[4 * i]);
+		}
+		return this->add(width, height, rgba.data(), srgb);
+	}
+
+	/// @brief Rearranges every texture's texels into a layout.
+	void set_layout(TextureLayout layout) {
+		if (layout == this->layout) { return; }
+		std::vector<std::uint32_t> texels;
+		for (Texture& texture : this->textures) {
+			for (std::uint32_t l = texture.first_resident_level; l < texture.level_count; ++l) {
+				std::uint32_t offset = static_cast<std::uint32_t>(texels.size());
+				texels.resize(texels.size() + TextureData::get_level_size(layout, texture.widths[l], texture.heights[l]));
+				for (std::uint32_t y = 0; y < texture.heights[l]; ++y) {
+					for (std::uint32_t x = 0; x < texture.widths[l]; ++x) {
+						texels[offset + TextureData::get_texel_index(layout, texture.widths[l], x, y)] =
+							this->texels[texture.offsets[l] + TextureData::get_texel_index(this->layout, texture.widths[l], x, y)];
+					}
+				}
+				texture.offsets[l] = offset;
+			}
+		}
+		this->texels.assign(texels.begin(), texels.end());
+		this->layout = layout;
+	}
+
+	/// @brief Pointers for kernels, refreshed for textures added since the last call.
+	TextureData* get_data() {
+		if (this->measure_bandwidth) {
+			this->touched_lines.resize((this->texels.size() / TextureData::line_texel_count + 31) / 32 + 1, 0);
+		}
+		this->data[0] = {
+			.textures = this->textures.data(),
+			.texture_count = this->textures.size(),
+			.texels = this->texels.data(),
+			.srgb_to_linear = this->srgb_to_linear.data(),
+			.layout = this->layout,
+			.filter = this->filter,
+			.mipmaps = this->mipmaps,
+			.touched_lines = this->measure_bandwidth ? this->touched_lines.data() : nullptr,
+			.cache = this->cache.get_data()
+		};
+		return this->data.data();
+	}
+
+	/// @brief Bytes of texels fetched (counting each cache line once) since the last reset.
+	std::size_t get_bytes_fetched() const {
+		std::size_t lines = 0;
+		for (std::uint32_t word : this->touched_lines) {
+			lines += std::popcount(word);
+		}
+		return lines * TextureData::line_texel_count * sizeof(std::uint32_t);
+	}
+
+	/// @brief Services the texture cache.  Call between frames.
+	void update() {
+		if (this->cache.get_page_count() > 0) {
+			this->cache.update();
+		}
+	}
+
+	void reset_bytes_fetched() {
+		std::fill(this->touched_lines.begin(), this->touched_lines.end(), 0);
+	}
+
+	Shared<Texture, SharedAllocator<Texture>> textures;
+	Shared<std::uint32_t, SharedAllocator<std::uint32_t>> texels;
+	Shared<Real, SharedAllocator<Real>> srgb_to_linear;
+	Shared<std::uint32_t, SharedAllocator<std::uint32_t>> touched_lines;
+
+	TextureLayout layout;
+	TextureFilter filter;
+	bool mipmaps;
+	bool measure_bandwidth;
+
+	TextureCache cache;
+
+private:
+	static constexpr std::uint32_t page_file_magic = 0x47504947; // "GIPG"
+
+	/// @brief A mip level, encoded row by row.
+	class Level {
+	public:
+		std::uint32_t width;
+		std::uint32_t height;
+		std::vector<std::uint32_t> texels;
+	};
+
+	Shared<TextureData, SharedAllocator<TextureData>> data;
+
+	/// @brief Builds an image's mip chain, filtering in linear space.
+	std::vector<Level> build_levels(std::uint32_t width, std::uint32_t height, const std::uint8_t* rgba, bool srgb) const {
+		std::vector<Level> levels;
+		std::vector<Vector3H> level(static_cast<std::size_t>(width) * height);
+		for (std::size_t i = 0; i < level.size(); ++i) {
+			level[i] = { this->decode(rgba[4 * i], srgb), this->decode(rgba[4 * i + 1], srgb), this->decode(rgba[4 * i + 2], srgb), rgba[4 * i + 3] / 255_r };
+		}
+		while (true) {
+			Level& encoded = levels.emplace_back(width, height, std::vector<std::uint32_t>(level.size()));
+			std::transform(level.begin(), level.end(), encoded.texels.begin(), [&](const Vector3H& color) { return TextureStore::encode(color, srgb); });
+			if ((width == 1 && height == 1) || levels.size() == Texture::max_level_count) { break; }
+			// Box filter down to the next level (odd edges reuse their last texel).
+			std::uint32_t next_width = std::max(width / 2, 1u);
+			std::uint32_t next_height = std::max(height / 2, 1u);
+			std::vector<Vector3H> next(static_cast<std::size_t>(next_width) * next_height);
+			for (std::uint32_t y = 0; y < next_height; ++y) {
+				for (std::uint32_t x = 0; x < next_width; ++x) {
+					std::uint32_t x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+					std::uint32_t y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+					next[y * next_width + x] = (level[y0 * width + x0] + level[y0 * width + x1] + level[y1 * width + x0] + level[y1 * width + x1]) / 4;
+				}
+			}
+			level = std::move(next);
+			width = next_width;
+			height = next_height;
+		}
+		return levels;
+	}
+
+	/// @brief Stores the next level of a texture in the store's layout.
+	/// @param texels width * height encoded texels, row by row.
+	void append_level(Texture& texture, std::uint32_t width, std::uint32_t height, const std::uint32_t* texels) {
+		std::uint32_t l = texture.level_count++;
+		texture.offsets[l] = static_cast<std::uint32_t>(this->texels.size());
+		texture.widths[l] = width;
+		texture.heights[l] = height;
+		this->texels.resize(this->texels.size() + TextureData::get_level_size(this->layout, width, height));
+		for (std::uint32_t y = 0; y < height; ++y) {
+			for (std::uint32_t x = 0; x < width; ++x) {
+				this->texels[texture.offsets[l] + TextureData::get_texel_index(this->layout, width, x, y)] = texels[y * width + x];
+			}
+		}
+	}
+
+	static Real decode_srgb(Real value) {
+		return value <= 0.04045_r ? value / 12.92_r : std::pow((value + 0.055_r) / 1.055_r, 2.4_r);
+	}
+
+	static Real encode_srgb(Real value) {
+		return value <= 0.0031308_r ? value * 12.92_r : 1.055_r * std::pow(value, 1 / 2.4_r) - 0.055_r;
+	}
+
+	Real decode(std::uint8_t value, bool srgb) const {
+		return srgb ? this->srgb_to_linear[value] : value / 255_r;
+	}
+
+	static std::uint32_t encode(const Vector3H& color, bool srgb) {
+		auto channel = [&](Real value, bool gamma) {
+			value = std::clamp(gamma ? TextureStore::encode_srgb(value) : value, 0_r, 1_r);
+			return static_cast<std::uint32_t>(value * 255 + 0.5_r);
+		};
+		return channel(color[0], srgb) | (channel(color[1], srgb) << 8) | (channel(color[2], srgb) << 16) | (channel(color[3], false) << 24);
+	}
+};
+
+#endif
\ No newline at end of file
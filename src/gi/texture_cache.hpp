@@ -0,0 +1,266 @@
+#ifndef GI_BAH8454_TEXTURE_CACHE
+#define GI_BAH8454_TEXTURE_CACHE
+
+// Include SYCL.
+#include <sycl/sycl.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "util.hpp"
+
+/// @brief Fixed-size pages of texels streamed from disk into a pool of bounded size in shared memory.
+/// Kernels look pages up through Data, which flags the ones that aren't resident.  Between frames, update hands the flagged pages to a background I/O thread, installs the pages it has finished reading and evicts the least recently used pages once the pool is at its budget.
+class TextureCache {
+public:
+	static constexpr std::uint32_t page_size = 64;
+	static constexpr std::uint32_t page_texel_count = page_size * page_size;
+	static constexpr std::uint32_t not_resident = std::numeric_limits<std::uint32_t>::max();
+
+	class Info {
+	public:
+		// Bytes of texels the pool may hold.
+		std::size_t memory_budget = 256 * 1024 * 1024;
+	};
+
+	/// @brief Counters of the last frame.
+	class Statistics {
+	public:
+		// Samples whose mip level was resident and samples that fell back to a coarser one.
+		std::size_t hits;
+		std::size_t misses;
+		Real hit_rate;
+		std::size_t resident_pages;
+		std::size_t resident_bytes;
+		std::size_t pages_in_flight;
+	};
+
+	/// @brief Raw pointers to the cache for kernels.
+	class Data {
+	public:
+		// Pool slot of each page, or not_resident.
+		const std::uint32_t* slots;
+		// Frame each page was last used in.
+		std::uint32_t* last_used;
+		// Pages kernels missed since the last update, a bit per page in 32-bit words.
+		std::uint32_t* requested;
+		const std::uint32_t* pool;
+		std::uint32_t frame;
+		// Hits and misses since the last update.
+		std::uint32_t* counters;
+
+		/// @brief The texels of a page (tiled like a texture level of page_size x page_size), or nullptr after requesting it if it isn't resident.
+		const std::uint32_t* get_page(std::uint32_t page) const {
+			std::uint32_t slot = this->slots[page];
+			if (slot == not_resident) {
+				sycl::atomic_ref<std::uint32_t, sycl::memory_order::relaxed, sycl::memory_scope::device>{ this->requested[page / 32] }.fetch_or(1u << (page % 32));
+				return nullptr;
+			}
+			sycl::atomic_ref<std::uint32_t, sycl::memory_order::relaxed, sycl::memory_scope::device>{ this->last_used[page] }.store(this->frame);
+			return this->pool + static_cast<std::size_t>(slot) * page_texel_count;
+		}
+
+		void record(bool hit) const {
+			sycl::atomic_ref<std::uint32_t, sycl::memory_order::relaxed, sycl::memory_scope::device>{ this->counters[hit ? 0 : 1] }.fetch_add(1);
+		}
+	};
+
+	TextureCache(sycl::queue& q, const Info& info) :
+		slots{ SharedAllocator<std::uint32_t>{ q } },
+		last_used{ SharedAllocator<std::uint32_t>{ q } },
+		requested{ SharedAllocator<std::uint32_t>{ q } },
+		pool{ SharedAllocator<std::uint32_t>{ q } },
+		counters{ 2, 0, SharedAllocator<std::uint32_t>{ q } },
+		slot_capacity{ std::max<std::size_t>(info.memory_budget / (page_texel_count * sizeof(std::uint32_t)), 1) }
+	{}
+
+	TextureCache(const TextureCache&) = delete;
+
+	/// @brief Registers count pages stored back to back in a file from an offset.
+	/// @return The index of the first page.
+	std::uint32_t add_pages(const std::string& path, std::size_t offset, std::uint32_t count) {
+		// The pool and the I/O thread wait for the first page file, so renderers without one don't pay for them.
+		if (!this->io_thread.joinable()) {
+			// Reserve the whole budget so slots never move while kernels hold pointers to them.
+			this->pool.reserve(this->slot_capacity * page_texel_count);
+			this->io_thread = std::jthread{ [this](std::stop_token stop) { this->load_pages(stop); } };
+		}
+		std::uint32_t first = static_cast<std::uint32_t>(this->pages.size());
+		std::uint32_t file = static_cast<std::uint32_t>(this->files.size());
+		{
+			std::lock_guard lock{ this->mutex };
+			this->files.push_back(path);
+			for (std::uint32_t i = 0; i < count; ++i) {
+				this->pages.push_back({ .file = file, .offset = offset + static_cast<std::size_t>(i) * page_texel_count * sizeof(std::uint32_t) });
+			}
+		}
+		this->in_flight.resize(this->pages.size(), false);
+		this->slots.resize(this->pages.size(), not_resident);
+		this->last_used.resize(this->pages.size(), 0);
+		this->requested.resize((this->pages.size() + 31) / 32, 0);
+		return first;
+	}
+
+	/// @brief Installs the pages read since the last call and queues the pages kernels missed.  Call between frames.
+	void update() {
+		this->statistics.hits = this->counters[0];
+		this->statistics.misses = this->counters[1];
+		std::size_t samples = this->statistics.hits + this->statistics.misses;
+		this->statistics.hit_rate = samples > 0 ? static_cast<Real>(this->statistics.hits) / samples : 1;
+		this->counters[0] = 0;
+		this->counters[1] = 0;
+		this->eviction_order.clear();
+		std::vector<LoadedPage> loaded;
+		{
+			std::lock_guard lock{ this->mutex };
+			loaded.swap(this->loaded);
+		}
+		for (LoadedPage& page : loaded) {
+			std::uint32_t slot = this->allocate_slot();
+			std::copy(page.texels.begin(), page.texels.end(), this->pool.begin() + static_cast<std::size_t>(slot) * page_texel_count);
+			this->slots[page.page] = slot;
+			this->slot_pages[slot] = page.page;
+			this->last_used[page.page] = this->frame;
+			this->in_flight[page.page] = false;
+		}
+		// Keep what is in flight within the budget, so the pages read never outnumber the slots to put them in.
+		std::size_t in_flight_count = this->statistics.pages_in_flight - loaded.size();
+		std::vector<std::uint32_t> requests;
+		for (std::uint32_t word = 0; word < this->requested.size(); ++word) {
+			std::uint32_t bits = this->requested[word];
+			this->requested[word] = 0;
+			for (; bits != 0; bits &= bits - 1) {
+				std::uint32_t page = word * 32 + std::countr_zero(bits);
+				if (this->in_flight[page] || this->slots[page] != not_resident || in_flight_count >= this->slot_capacity) { continue; }
+				this->in_flight[page] = true;
+				requests.push_back(page);
+				++in_flight_count;
+			}
+		}
+		if (!requests.empty()) {
+			std::lock_guard lock{ this->mutex };
+			this->pending.insert(this->pending.end(), requests.begin(), requests.end());
+			this->condition.notify_one();
+		}
+		this->statistics.pages_in_flight = in_flight_count;
+		this->statistics.resident_pages = this->slot_pages.size();
+		this->statistics.resident_bytes = this->statistics.resident_pages * page_texel_count * sizeof(std::uint32_t);
+		++this->frame;
+	}
+
+	Data get_data() {
+		return {
+			.slots = this->slots.data(),
+			.last_used = this->last_used.data(),
+			.requested = this->requested.data(),
+			.pool = this->pool.data(),
+			.frame = this->frame,
+			.counters = this->counters.data()
+		};
+	}
+
+	const Statistics& get_statistics() const {
+		return this->statistics;
+	}
+
+	std::size_t get_page_count() const {
+		return this->pages.size();
+	}
+
+	Shared<std::uint32_t, SharedAllocator<std::uint32_t>> slots;
+	Shared<std::uint32_t, SharedAllocator<std::uint32_t>> last_used;
+	Shared<std::uint32_t, SharedAllocator<std::uint32_t>> requested;
+	Shared<std::uint32_t, SharedAllocator<std::uint32_t>> pool;
+	Shared<std::uint32_t, SharedAllocator<std::uint32_t>> counters;
+
+private:
+	class Page {
+	public:
+		std::uint32_t file;
+		std::size_t offset;
+	};
+
+	class LoadedPage {
+	public:
+		std::uint32_t page;
+		std::vector<std::uint32_t> texels;
+	};
+
+	/// @brief A slot for a new page, growing the pool up to the budget and then evicting the least recently used page.
+	std::uint32_t allocate_slot() {
+		if (this->slot_pages.size() < this->slot_capacity) {
+			this->pool.resize(this->pool.size() + page_texel_count);
+			this->slot_pages.push_back(not_resident);
+			return static_cast<std::uint32_t>(this->slot_pages.size() - 1);
+		}
+		// Rank the resident pages once per batch of evictions.
+		if (this->eviction_order.empty()) {
+			for (std::uint32_t slot = 0; slot < this->slot_pages.size(); ++slot) {
+				this->eviction_order.push_back(slot);
+			}
+			std::sort(this->eviction_order.begin(), this->eviction_order.end(), [&](std::uint32_t a, std::uint32_t b) {
+				return this->last_used[this->slot_pages[a]] > this->last_used[this->slot_pages[b]];
+			});
+		}
+		std::uint32_t slot = this->eviction_order.back();
+		this->eviction_order.pop_back();
+		this->slots[this->slot_pages[slot]] = not_resident;
+		return slot;
+	}
+
+	/// @brief Body of the I/O thread: reads queued pages until stopped.
+	void load_pages(std::stop_token stop) {
+		std::vector<std::ifstream> streams;
+		std::unique_lock lock{ this->mutex };
+		while (this->condition.wait(lock, stop, [&]() { return !this->pending.empty(); })) {
+			std::uint32_t page = this->pending.front();
+			this->pending.pop_front();
+			Page location = this->pages[page];
+			if (streams.size() < this->files.size()) {
+				for (std::size_t i = streams.size(); i < this->files.size(); ++i) {
+					streams.emplace_back(this->files[i], std::ios::binary);
+				}
+			}
+			lock.unlock();
+			LoadedPage loaded{ page, std::vector<std::uint32_t>(page_texel_count) };
+			std::ifstream& stream = streams[location.file];
+			stream.clear();
+			stream.seekg(location.offset);
+			stream.read(reinterpret_cast<char*>(loaded.texels.data()), page_texel_count * sizeof(std::uint32_t));
+			lock.lock();
+			this->loaded.push_back(std::move(loaded));
+		}
+	}
+
+	std::size_t slot_capacity;
+	std::uint32_t frame = 1;
+	Statistics statistics{ .hits = 0, .misses = 0, .hit_rate = 1, .resident_pages = 0, .resident_bytes = 0, .pages_in_flight = 0 };
+	// Page in each slot of the pool.
+	std::vector<std::uint32_t> slot_pages;
+	std::vector<bool> in_flight;
+	// Slots to evict next, least recently used last.
+	std::vector<std::uint32_t> eviction_order;
+
+	// Shared with the I/O thread.
+	std::mutex mutex;
+	std::condition_variable_any condition;
+	std::vector<std::string> files;
+	std::vector<Page> pages;
+	std::deque<std::uint32_t> pending;
+	std::vector<LoadedPage> loaded;
+
+	// Started by the first add_pages.
+	std::jthread io_thread;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,360 @@
+#ifndef GI_BAH8454_TILE_COORDINATOR
+#define GI_BAH8454_TILE_COORDINATOR
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "util.hpp"
+#include "partial_update.hpp"
+
+/// @brief A tile a coordinator asks a worker to draw.  Sent as is over TCP, so coordinator and workers must share a byte order.
+class TileJob {
+public:
+	std::uint32_t id;
+	// Size the rays are generated for, and the smaller size they're drawn at under dynamic resolution.
+	std::uint32_t output_width;
+	std::uint32_t output_height;
+	std::uint32_t width;
+	std::uint32_t height;
+	// Seeds the random numbers, so a tile comes out the same on any worker.
+	std::uint32_t frame_index;
+	// The camera's view matrix, column major.
+	std::array<Real, 16> view;
+	Tile tile;
+};
+
+/// @brief The header of a drawn tile a worker sends back, followed by the radiance of its pixels row by row.
+class TileResult {
+public:
+	std::uint32_t id;
+	Tile tile;
+};
+
+/// @brief Draws frames on worker processes (see TileWorker) over TCP instead of on this device.
+/// Each frame is split into tiles that are handed to workers as they finish earlier ones, a few at a time to hide the round trip.
+/// Tiles that take much longer than usual are sent to a second worker and the first result is kept, and the tiles of a worker that goes away are sent to the others.
+class TileCoordinator {
+public:
+	class Info {
+	public:
+		// host:port of every worker; none draws locally.
+		std::vector<std::string> workers;
+		// Width and height of the tiles whole frames are split into.
+		std::uint32_t tile_size = 64;
+		// Tiles sent to a worker before it returns any.
+		std::uint32_t tiles_in_flight = 2;
+		// A tile is also sent to another worker once it has been out this many times as long as tiles usually take.
+		Real straggler_factor = 3;
+		// Seconds a frame may take before the workers are given up on and it's drawn locally.
+		Real timeout = 10;
+		// Print how each frame was drawn, for debugging.
+		bool log = false;
+	};
+
+	TileCoordinator(const Info& info) : info{ info }, work{ this->io_context.get_executor() }, timer{ this->io_context } {
+		// Which workers have a tile is kept in a bit mask.
+		if (info.workers.size() > 64) {
+			throw std::runtime_error{ "At most 64 tile workers are supported." };
+		}
+		for (const std::string& address : info.workers) {
+			std::size_t colon = address.rfind(':');
+			if (colon == std::string::npos) {
+				throw std::runtime_error{ "Tile worker address \"" + address + "\" has no port." };
+			}
+			this->workers.push_back(std::make_unique<Worker>(this->io_context, address.substr(0, colon), address.substr(colon + 1)));
+		}
+	}
+
+	TileCoordinator(const TileCoordinator&) = delete;
+
+	/// @brief Draws a frame on the workers, writing the radiance of its tiles into pixels.
+	/// @param tiles The tiles to draw; every pixel if empty.
+	/// @return Whether it was drawn; not if no worker could be reached, leaving the frame to be drawn locally.
+	bool draw(
+		Vector3* pixels, const Matrix3H& view, std::size_t output_width, std::size_t output_height,
+		std::size_t width, std::size_t height, std::uint32_t frame_index, const std::vector<Tile>& tiles
+	) {
+		auto start = Clock::now();
+		// Ids of earlier frames' jobs stay unique, so their late results are recognized and dropped.
+		this->first_id += static_cast<std::uint32_t>(this->tiles.size());
+		this->pixels = pixels;
+		this->job = { .output_width = static_cast<std::uint32_t>(output_width), .output_height = static_cast<std::uint32_t>(output_height),
+			.width = static_cast<std::uint32_t>(width), .height = static_cast<std::uint32_t>(height), .frame_index = frame_index };
+		std::copy(view.data(), view.data() + 16, this->job.view.begin());
+		this->tiles.clear();
+		this->queue.clear();
+		if (tiles.empty()) {
+			for (std::uint32_t y = 0; y < height; y += this->info.tile_size) {
+				for (std::uint32_t x = 0; x < width; x += this->info.tile_size) {
+					this->tiles.push_back({ .tile = { x, y, std::min<std::uint32_t>(this->info.tile_size, static_cast<std::uint32_t>(width) - x), std::min<std::uint32_t>(this->info.tile_size, static_cast<std::uint32_t>(height) - y) } });
+				}
+			}
+		} else {
+			for (const Tile& tile : tiles) {
+				this->tiles.push_back({ .tile = tile });
+			}
+		}
+		for (std::uint32_t i = 0; i < this->tiles.size(); ++i) {
+			this->queue.push_back(i);
+		}
+		this->remaining = this->tiles.size();
+		this->reassigned = 0;
+		for (std::size_t w = 0; w < this->workers.size(); ++w) {
+			this->connect(w);
+		}
+		this->tick();
+		auto deadline = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<Real>{ this->info.timeout });
+		while (this->remaining > 0) {
+			bool reachable = false;
+			for (const auto& worker : this->workers) {
+				reachable = reachable || worker->connected || worker->connecting;
+			}
+			if (!reachable || Clock::now() > deadline) {
+				// Workers still connecting or holding jobs have stopped answering; drop them, so the next frames don't wait for them too.
+				for (std::size_t w = 0; w < this->workers.size(); ++w) {
+					if (this->workers[w]->connecting || !this->workers[w]->sent.empty()) {
+						this->disconnect(w, "timed out");
+					}
+				}
+				if (this->info.log) {
+					std::cout << "Tile workers " << (reachable ? "timed out" : "unreachable") << ", drawing locally" << std::endl;
+				}
+				this->timer.cancel();
+				return false;
+			}
+			this->dispatch();
+			this->io_context.run_one();
+		}
+		this->timer.cancel();
+		if (this->info.log) {
+			std::chrono::duration<Real> time = Clock::now() - start;
+			std::cout << "Distributed " << this->tiles.size() << " tiles in " << time.count() << " seconds (" << this->reassigned << " reassigned, "
+				<< this->tile_time * 1000 << " ms per tile)" << std::endl;
+		}
+		return true;
+	}
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	class Worker {
+	public:
+		Worker(boost::asio::io_context& io_context, const std::string& host, const std::string& port) : socket{ io_context }, host{ host }, port{ port } {}
+
+		boost::asio::ip::tcp::socket socket;
+		std::string host;
+		std::string port;
+		bool connected = false;
+		bool connecting = false;
+		// When to try connecting again after failing.
+		Clock::time_point next_connect = Clock::now();
+		// Counts the connections closed, so handlers of an earlier connection's operations are ignored.
+		std::uint32_t connection = 0;
+		// Id and tile of the jobs sent whose results haven't arrived, including those of earlier frames, oldest first.
+		std::deque<TileResult> sent;
+		// Jobs waiting to be written, one write at a time.
+		std::deque<TileJob> writes;
+		TileResult result;
+		std::vector<Vector3> radiance;
+	};
+
+	class TileState {
+	public:
+		Tile tile;
+		bool done = false;
+		// Bit w is set while worker w has the tile.
+		std::uint64_t workers = 0;
+		Clock::time_point sent;
+	};
+
+	void connect(std::size_t w) {
+		Worker& worker = *this->workers[w];
+		if (worker.connected || worker.connecting || Clock::now() < worker.next_connect) { return; }
+		worker.connecting = true;
+		boost::system::error_code error;
+		auto endpoints = boost::asio::ip::tcp::resolver{ this->io_context }.resolve(worker.host, worker.port, error);
+		if (error) {
+			return this->disconnect(w, error.message());
+		}
+		boost::asio::async_connect(worker.socket, endpoints, [this, w, connection = worker.connection](boost::system::error_code error, const boost::asio::ip::tcp::endpoint&) {
+			Worker& worker = *this->workers[w];
+			if (connection != worker.connection) { return; }
+			worker.connecting = false;
+			if (error) {
+				return this->disconnect(w, error.message());
+			}
+			worker.socket.set_option(boost::asio::ip::tcp::no_delay{ true });
+			worker.connected = true;
+			this->read(w);
+		});
+	}
+
+	/// @brief Gives the tiles of a worker that failed to the others and waits a while before connecting to it again.
+	void disconnect(std::size_t w, const std::string& reason) {
+		Worker& worker = *this->workers[w];
+		std::cout << "Tile worker " << worker.host << ":" << worker.port << ": " << reason << std::endl;
+		boost::system::error_code ignored;
+		worker.socket.close(ignored);
+		++worker.connection;
+		worker.connected = false;
+		worker.connecting = false;
+		worker.sent.clear();
+		worker.writes.clear();
+		worker.next_connect = Clock::now() + std::chrono::seconds{ 1 };
+		for (std::uint32_t i = 0; i < this->tiles.size(); ++i) {
+			TileState& state = this->tiles[i];
+			if (state.done || !(state.workers & (1ull << w))) { continue; }
+			state.workers &= ~(1ull << w);
+			if (state.workers == 0) {
+				this->queue.push_front(i);
+			}
+		}
+	}
+
+	/// @brief Sends tiles to every worker with room for more: queued tiles first, then stragglers out with other workers.
+	void dispatch() {
+		auto now = Clock::now();
+		for (std::size_t w = 0; w < this->workers.size(); ++w) {
+			Worker& worker = *this->workers[w];
+			while (worker.connected && worker.sent.size() < this->info.tiles_in_flight) {
+				std::optional<std::uint32_t> next;
+				if (!this->queue.empty()) {
+					next = this->queue.front();
+					this->queue.pop_front();
+				} else {
+					next = this->find_straggler(w, now);
+					if (!next) { break; }
+					++this->reassigned;
+				}
+				TileState& state = this->tiles[*next];
+				if (state.workers == 0) {
+					state.sent = now;
+				}
+				state.workers |= 1ull << w;
+				TileJob job = this->job;
+				job.id = this->first_id + *next;
+				job.tile = state.tile;
+				worker.sent.push_back({ job.id, job.tile });
+				worker.writes.push_back(job);
+				if (worker.writes.size() == 1) {
+					this->write(w);
+				}
+			}
+		}
+	}
+
+	/// @brief A tile out with other workers for much longer than tiles usually take, if any.
+	std::optional<std::uint32_t> find_straggler(std::size_t w, Clock::time_point now) const {
+		if (this->tile_time <= 0) { return {}; }
+		auto limit = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<Real>{ this->info.straggler_factor * this->tile_time });
+		for (std::uint32_t i = 0; i < this->tiles.size(); ++i) {
+			const TileState& state = this->tiles[i];
+			if (!state.done && state.workers != 0 && !(state.workers & (1ull << w)) && now - state.sent > limit) {
+				return i;
+			}
+		}
+		return {};
+	}
+
+	void write(std::size_t w) {
+		Worker& worker = *this->workers[w];
+		boost::asio::async_write(worker.socket, boost::asio::buffer(&worker.writes.front(), sizeof(TileJob)), [this, w, connection = worker.connection](boost::system::error_code error, std::size_t) {
+			Worker& worker = *this->workers[w];
+			if (connection != worker.connection) { return; }
+			if (error) {
+				return this->disconnect(w, error.message());
+			}
+			worker.writes.pop_front();
+			if (!worker.writes.empty()) {
+				this->write(w);
+			}
+		});
+	}
+
+	void read(std::size_t w) {
+		Worker& worker = *this->workers[w];
+		boost::asio::async_read(worker.socket, boost::asio::buffer(&worker.result, sizeof(TileResult)), [this, w, connection = worker.connection](boost::system::error_code error, std::size_t) {
+			Worker& worker = *this->workers[w];
+			if (connection != worker.connection) { return; }
+			if (error) {
+				return this->disconnect(w, error.message());
+			}
+			// Workers answer in order, so a result that isn't for the oldest job sent is garbage; its size can't be trusted either.
+			if (worker.sent.empty() || worker.result.id != worker.sent.front().id || worker.result.tile != worker.sent.front().tile) {
+				return this->disconnect(w, "result doesn't match the job sent");
+			}
+			worker.radiance.resize(static_cast<std::size_t>(worker.result.tile.width) * worker.result.tile.height);
+			boost::asio::async_read(worker.socket, boost::asio::buffer(worker.radiance.data(), worker.radiance.size() * sizeof(Vector3)), [this, w, connection](boost::system::error_code error, std::size_t) {
+				if (connection != this->workers[w]->connection) { return; }
+				if (error) {
+					return this->disconnect(w, error.message());
+				}
+				this->receive(w);
+				this->read(w);
+			});
+		});
+	}
+
+	/// @brief Copies a result into the frame, unless it's from an earlier frame or another worker was first.
+	void receive(std::size_t w) {
+		Worker& worker = *this->workers[w];
+		worker.sent.pop_front();
+		std::uint32_t i = worker.result.id - this->first_id;
+		if (i >= this->tiles.size() || this->tiles[i].done) { return; }
+		TileState& state = this->tiles[i];
+		const Tile& tile = state.tile;
+		for (std::uint32_t y = 0; y < tile.height; ++y) {
+			std::copy_n(worker.radiance.data() + y * tile.width, tile.width, this->pixels + (tile.y + y) * this->job.width + tile.x);
+		}
+		state.done = true;
+		--this->remaining;
+		// Smooth the time tiles take, to tell stragglers from tiles that are simply expensive.
+		Real time = std::chrono::duration<Real>{ Clock::now() - state.sent }.count();
+		this->tile_time = this->tile_time == 0 ? time : 0.875_r * this->tile_time + 0.125_r * time;
+	}
+
+	/// @brief Wakes the frame loop regularly, to reassign stragglers and retry workers while nothing else happens.
+	void tick() {
+		this->timer.expires_after(std::chrono::milliseconds{ 5 });
+		this->timer.async_wait([this](boost::system::error_code error) {
+			if (error || this->remaining == 0) { return; }
+			for (std::size_t w = 0; w < this->workers.size(); ++w) {
+				this->connect(w);
+			}
+			this->tick();
+		});
+	}
+
+	Info info;
+	boost::asio::io_context io_context;
+	// Keeps run_one waiting while no operation is pending.
+	boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work;
+	boost::asio::steady_timer timer;
+	std::vector<std::unique_ptr<Worker>> workers;
+
+	// The frame being drawn.
+	TileJob job{};
+	Vector3* pixels = nullptr;
+	std::vector<TileState> tiles;
+	// Tiles not sent to any worker yet.
+	std::deque<std::uint32_t> queue;
+	std::size_t remaining = 0;
+	std::size_t reassigned = 0;
+	// Id of the frame's first tile.
+	std::uint32_t first_id = 0;
+	// Smoothed seconds from sending a tile to receiving it.
+	Real tile_time = 0;
+};
+
+#endif
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <utility>
 #include <memory>
 #include <exception>
+#include <cstdint>
 
 // Eigen misconfigures itself if it sees SYCL_DEVICE_ONLY so we must include SYCL first and then disable this definition.
 #include <sycl/sycl.hpp>
@@ -92,7 +93,8 @@ public:
     SharedAllocator(const SharedAllocator<U>& other) : q{ other.q } {}
 
 	T* allocate(std::size_t n) {
-        return sycl::malloc_shared<T>(sizeof(T) * n, this->q);
+        // Respect over-aligned types (e.g. the vector lanes of wide BVH nodes).
+        return sycl::aligned_alloc_shared<T>(alignof(T), n, this->q);
     }
 
 	void deallocate(T* p, std::size_t n) {
@@ -105,6 +107,13 @@ public:
 class Ray;
 class FilmPlane;
 class Light;
+enum class LightSampling : std::uint32_t;
+class Material;
+class TextureData;
+class EnvironmentData;
+class BVHNode;
+template <std::size_t width> class WideBVHNode;
+template <std::size_t width> class CompressedWideBVHNode;
 
 template <typename ObjectType>
 class DeviceData {
@@ -113,6 +122,8 @@ public:
 	Matrix3H* view;
 	FilmPlane* film_plane;
 	Ray* rays;
+	// Angle between neighbouring primary rays, from which ray cones estimate texture footprints.
+	Real pixel_spread_angle;
 	// Frame buffer data.
 	Vector3* pixels;
 	// Renderer data.
@@ -120,6 +131,26 @@ public:
 	std::size_t object_count;
 	Light* lights;
 	std::size_t light_count;
+	std::size_t light_samples;
+	LightSampling light_sampling;
+	// Frames rendered so far, for seeding random numbers.
+	std::uint32_t frame_index;
+	Material* materials;
+	std::size_t material_count;
+	TextureData* textures;
+	EnvironmentData* environment;
+	// Acceleration structure data.  Only the node array matching bvh_width and bvh_compressed is populated.
+	std::size_t bvh_width;
+	bool bvh_compressed;
+	BVHNode* bvh_nodes;
+	std::size_t bvh_node_count;
+	WideBVHNode<4>* bvh4_nodes;
+	std::size_t bvh4_node_count;
+	WideBVHNode<8>* bvh8_nodes;
+	std::size_t bvh8_node_count;
+	CompressedWideBVHNode<4>* compressed_bvh4_nodes;
+	CompressedWideBVHNode<8>* compressed_bvh8_nodes;
+	std::uint32_t* bvh_indices;
 };
 
 template <typename T>
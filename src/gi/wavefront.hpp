@@ -0,0 +1,206 @@
+#ifndef GI_BAH8454_WAVEFRONT
+#define GI_BAH8454_WAVEFRONT
+
+// Include SYCL.
+#include <sycl/sycl.hpp>
+
+#include <cstdint>
+#include <limits>
+
+#include "util.hpp"
+#include "ray.hpp"
+#include "bvh/aabb.hpp"
+#include "bvh/lbvh_builder.hpp"
+#include "bvh/radix_sort.hpp"
+
+/// @brief Path segments waiting to be traced by the wavefront integrator, stored as structure of arrays in shared memory.
+/// Every stage kernel reads and writes one entry per path, so neighbouring work items touch neighbouring memory.
+class RayQueue {
+public:
+	/// @brief Raw pointers to the queue for kernels to capture.
+	class Data {
+	public:
+		Vector3* origins;
+		Vector3* directions;
+		// Frame buffer pixel the path contributes to.
+		std::uint32_t* pixels;
+		// Weight of the path's contribution (the product of the reflection/transmission constants so far).
+		Vector3* throughputs;
+		std::uint32_t* depths;
+		// Number of paths in the queue.  Stages that emit paths append to it atomically, which also compacts the queue.
+		std::uint32_t* count;
+
+		/// @brief Appends a path (from a kernel).
+		void push(const Ray& ray, std::uint32_t pixel, const Vector3& throughput, std::uint32_t depth) const {
+			sycl::atomic_ref<std::uint32_t, sycl::memory_order::relaxed, sycl::memory_scope::device> counter{ *this->count };
+			std::uint32_t i = counter.fetch_add(1);
+			this->origins[i] = ray.origin;
+			this->directions[i] = ray.direction;
+			this->pixels[i] = pixel;
+			this->throughputs[i] = throughput;
+			this->depths[i] = depth;
+		}
+
+		Ray get_ray(std::size_t i) const {
+			return { this->origins[i], this->directions[i] };
+		}
+	};
+
+	RayQueue(sycl::queue& q) :
+		origins{ SharedAllocator<Vector3>{ q } },
+		directions{ SharedAllocator<Vector3>{ q } },
+		pixels{ SharedAllocator<std::uint32_t>{ q } },
+		throughputs{ SharedAllocator<Vector3>{ q } },
+		depths{ SharedAllocator<std::uint32_t>{ q } },
+		count{ 1, 0, SharedAllocator<std::uint32_t>{ q } }
+	{}
+
+	/// @brief Makes room for capacity paths and empties the queue.
+	void reset(std::size_t capacity) {
+		if (this->origins.size() < capacity) {
+			this->origins.resize(capacity);
+			this->directions.resize(capacity);
+			this->pixels.resize(capacity);
+			this->throughputs.resize(capacity);
+			this->depths.resize(capacity);
+		}
+		this->count[0] = 0;
+	}
+
+	std::size_t size() const {
+		return this->count[0];
+	}
+
+	/// @brief Fills this queue with count paths of source, in the given order.
+	void gather(sycl::queue& q, const RayQueue::Data& source, const std::uint32_t* order, std::size_t count) {
+		q.parallel_for(
+			{ count },
+			[source, destination = this->get_data(), order](std::size_t i) {
+				std::uint32_t j = order[i];
+				destination.origins[i] = source.origins[j];
+				destination.directions[i] = source.directions[j];
+				destination.pixels[i] = source.pixels[j];
+				destination.throughputs[i] = source.throughputs[j];
+				destination.depths[i] = source.depths[j];
+			}
+		).wait();
+		this->count[0] = static_cast<std::uint32_t>(count);
+	}
+
+	Data get_data() {
+		return {
+			.origins = this->origins.data(),
+			.directions = this->directions.data(),
+			.pixels = this->pixels.data(),
+			.throughputs = this->throughputs.data(),
+			.depths = this->depths.data(),
+			.count = this->count.data()
+		};
+	}
+
+	Shared<Vector3, SharedAllocator<Vector3>> origins;
+	Shared<Vector3, SharedAllocator<Vector3>> directions;
+	Shared<std::uint32_t, SharedAllocator<std::uint32_t>> pixels;
+	Shared<Vector3, SharedAllocator<Vector3>> throughputs;
+	Shared<std::uint32_t, SharedAllocator<std::uint32_t>> depths;
+	Shared<std::uint32_t, SharedAllocator<std::uint32_t>> count;
+};
+
+/// @brief Closest hits (from the extend stage) and shadow ray results (from the shadow stage) of the paths in a RayQueue, entry for entry.
+class HitQueue {
+public:
+	static constexpr std::uint32_t no_hit = std::numeric_limits<std::uint32_t>::max();
+
+	/// @brief Raw pointers to the queue for kernels to capture.
+	class Data {
+	public:
+		// Index of the object hit, or no_hit.
+		std::uint32_t* objects;
+		Real* distances;
+		Vector3* barycentrics;
+		// Whether the light is blocked from the hit.
+		std::uint8_t* occluded;
+
+		Hit get_hit(std::size_t i) const {
+			return { .distance = this->distances[i], .barycentric = this->barycentrics[i] };
+		}
+	};
+
+	HitQueue(sycl::queue& q) :
+		objects{ SharedAllocator<std::uint32_t>{ q } },
+		distances{ SharedAllocator<Real>{ q } },
+		barycentrics{ SharedAllocator<Vector3>{ q } },
+		occluded{ SharedAllocator<std::uint8_t>{ q } }
+	{}
+
+	void reserve(std::size_t capacity) {
+		if (this->objects.size() < capacity) {
+			this->objects.resize(capacity);
+			this->distances.resize(capacity);
+			this->barycentrics.resize(capacity);
+			this->occluded.resize(capacity);
+		}
+	}
+
+	Data get_data() {
+		return {
+			.objects = this->objects.data(),
+			.distances = this->distances.data(),
+			.barycentrics = this->barycentrics.data(),
+			.occluded = this->occluded.data()
+		};
+	}
+
+	Shared<std::uint32_t, SharedAllocator<std::uint32_t>> objects;
+	Shared<Real, SharedAllocator<Real>> distances;
+	Shared<Vector3, SharedAllocator<Vector3>> barycentrics;
+	Shared<std::uint8_t, SharedAllocator<std::uint8_t>> occluded;
+};
+
+/// @brief Sort key grouping rays that leave from nearby points in similar directions: the direction's octant above a 29-bit Morton code of the origin within the scene bounds.
+/// Neighbouring rays in a sorted queue then tend to visit the same BVH nodes.
+inline std::uint32_t get_ray_sort_key(const Vector3& origin, const Vector3& direction, const AABB& scene_bounds) {
+	std::uint32_t octant = (direction.x() < 0 ? 4u : 0u) | (direction.y() < 0 ? 2u : 0u) | (direction.z() < 0 ? 1u : 0u);
+	Vector3 extent = scene_bounds.extent().cwiseMax(Vector3{ 1e-6_r, 1e-6_r, 1e-6_r });
+	std::uint32_t code = morton::encode<std::uint32_t>((origin - scene_bounds.minimum).cwiseQuotient(extent));
+	return (octant << 29) | (code >> 1);
+}
+
+/// @brief Orders the entries of a queue by 32-bit keys, for the wavefront integrator's optional coherence passes.
+class QueueSorter {
+public:
+	QueueSorter(sycl::queue& q) :
+		q{ q },
+		keys{ SharedAllocator<std::uint32_t>{ q } },
+		order{ SharedAllocator<std::uint32_t>{ q } },
+		sorter{ q }
+	{}
+
+	void reserve(std::size_t capacity) {
+		if (this->keys.size() < capacity) {
+			this->keys.resize(capacity);
+			this->order.resize(capacity);
+		}
+	}
+
+	/// @brief Sorts the first count keys (filled in by the caller), leaving in order the entry that goes at each position.
+	void sort(std::size_t count) {
+		this->q.parallel_for(
+			{ count },
+			[order = this->order.data()](std::size_t i) {
+				order[i] = static_cast<std::uint32_t>(i);
+			}
+		).wait();
+		this->sorter.sort(this->keys.data(), this->order.data(), count);
+	}
+
+	sycl::queue& q;
+
+	Shared<std::uint32_t, SharedAllocator<std::uint32_t>> keys;
+	Shared<std::uint32_t, SharedAllocator<std::uint32_t>> order;
+
+private:
+	RadixSorter<std::uint32_t> sorter;
+};
+
+#endif
\ No newline at end of file
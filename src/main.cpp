@@ -1,47 +1,85 @@
 ﻿#include <iostream>
 #include <execution>
 #include <algorithm>
+#include <ranges>
+#include <string>
+#include <string_view>
 
 #include "application.hpp"
 
 #include <sycl/sycl.hpp>
 
-auto on_load = [] <RenderableObject... ObjectTypes> (Renderer<ObjectTypes...>& self) {
+auto on_load = [] <typename Shaders, RenderableObject... ObjectTypes> (Renderer<Shaders, ObjectTypes...>& self) {
+    std::uint32_t glass = self.add_material({
+        .albedo_source = Material::Albedo::normal,
+        .transmission_constant = 0.8,
+        .medium_index = 0.95
+    });
+    std::uint32_t mirror = self.add_material({
+        .albedo_source = Material::Albedo::normal,
+        .reflection_constant = 1
+    });
+    std::uint32_t checkerboard = self.add_material({
+        .albedo_source = Material::Albedo::checkerboard,
+        .albedo = { 1, 0, 0 },
+        .checker_albedo = { 1, 1, 0 },
+        .checker_count = { 30, 30 }
+    });
+    // std::uint32_t image = self.add_material({
+    //     .albedo_source = Material::Albedo::texture,
+    //     .albedo_texture = self.textures.load_ppm("textures/checkerboard.ppm")
+    // });
+    // std::uint32_t terrain = self.add_material({
+    //     .albedo_source = Material::Albedo::texture,
+    //     .albedo_texture = self.textures.open_page_file("textures/terrain.pages")
+    // });
+
     self.objects.push_back(
         Sphere(
             { 0, 0, 0, 1 }, 0.5,
-            { 0, 0.8, 0.95 }
+            glass
         )
     );
     self.objects.push_back(
         Sphere(
             { 0.75, -0.5, -1.1, 1 }, 0.5,
-            { 1, 0, 1 }
+            mirror
         )
     );
     self.objects.push_back(
         UVTriangle(
             { Vector3H{ -6, -1.25, 6, 1 }, Vector3H{ -6, -1.25, -6, 1 }, Vector3H{ 6, -1.25, -6, 1 } },
             { Vector2{ 0, 0 }, Vector2{ 0, 1 }, Vector2{ 1, 1 } },
-            { }
+            checkerboard
         )
     );
     self.objects.push_back(
         UVTriangle(
             { Vector3H{ 6, -1.25, -6, 1 }, Vector3H{ 6, -1.25, 6, 1 }, Vector3H{ -6, -1.25, 6, 1 } },
             { Vector2{ 1, 1 }, Vector2{ 1, 0 }, Vector2{ 0, 0 } },
-            { }
+            checkerboard
         )
     );
 
     self.lights.push_back(
         Light{ Vector3H{ 0, 1, 2, 1 } }
     );
+    // self.environment.load_hdr("textures/sky.hdr");
+    // self.lights.push_back(
+    //     Light::rectangle(Vector3H{ -0.5, 2, 2.5, 1 }, Vector3{ 0, 0, -1 }, Vector3{ 1, 0, 0 }, Vector3{ 4, 4, 4 })
+    // );
 
     // self.load_ply("/mnt/c/Users/bah/Documents/RIT/Semester 7/GI/gi/src/ply/bun_zipper_res2.ply");
+    // self.load_random_triangles(10'000'000);
+    // self.benchmark_bvh_builders();
+    // self.benchmark_bvh_layouts();
+    // self.benchmark_primary_traversal();
+    // self.benchmark_wavefront_sorting();
+    // self.benchmark_texture_bandwidth();
+    // self.benchmark_light_sampling();
 };
 
-auto on_frame = [direction = true, speed = 1] <RenderableObject... ObjectTypes> (Renderer<ObjectTypes...>& self, Real delta) mutable {
+auto on_frame = [direction = true, speed = 1] <typename Shaders, RenderableObject... ObjectTypes> (Renderer<Shaders, ObjectTypes...>& self, Real delta) mutable {
     // visit([&](auto& object) {
     //     if constexpr (std::is_same_v<decltype(object), Sphere&>) {
     //         if (object.world_position[0] > 2) {
@@ -59,7 +97,8 @@ auto on_frame = [direction = true, speed = 1] <RenderableObject... ObjectTypes>
     // }, self.objects[0]);
 };
 
-int main() {
+// Runs the server, or with --worker PORT draws tiles for servers started with --workers HOST:PORT,HOST:PORT,...
+int main(int argc, char** argv) {
     // for (const auto& platform : sycl::platform::get_platforms()) {
     //     std::cout << "Platform: " << platform.get_info<sycl::info::platform::name>() << std::endl;
         
@@ -69,26 +108,43 @@ int main() {
     // }
 
     try {
-        Application<Sphere, UVTriangle/*, PhongTriangle*/> app{};
-        auto thread = app.launch_web(
-            8080,
-            {
-                .frame_buffer = { .width = 1024, .height = 768 },
-                .camera = {
-                    .position = { 0, 0, 2 },
-                    //.position = { 0, 0.5, 0.3 },
-                    .center = { 0, 0, -1 },
-                    .up = { 0, 1, 0 }
-                },
-                .callbacks = {
-                    .on_load = on_load,
-                    .on_frame = on_frame
+        Application<ShaderRegistry<shader::Phong/*, shader::Unlit*/>, Sphere, UVTriangle/*, PhongTriangle*/> app{};
+        Renderer<ShaderRegistry<shader::Phong/*, shader::Unlit*/>, Sphere, UVTriangle/*, PhongTriangle*/>::Info info{
+            .frame_buffer = { .width = 1024, .height = 768 },
+            .camera = {
+                .position = { 0, 0, 2 },
+                //.position = { 0, 0.5, 0.3 },
+                .center = { 0, 0, -1 },
+                .up = { 0, 1, 0 }
+            },
+            .callbacks = {
+                .on_load = on_load,
+                .on_frame = on_frame
+            },
+            // Lower the resolution when frames take too long (partial updates are then skipped).
+            //.dynamic_resolution = { .enabled = true },
+            // Redraw half the tiles per frame while moving (partial updates are only sent at full resolution).
+            //.partial_update = { .pattern = PartialUpdate::Pattern::interlaced },
+            // Split frames between every SYCL device found, or between several CPU queues with DeviceSplit::Selection::host (only the wavefront integrator shades on the devices).
+            //.devices = { .selection = DeviceSplit::Selection::all }
+        };
+        for (int i = 1; i + 1 < argc; i += 2) {
+            std::string_view option = argv[i];
+            std::string_view value = argv[i + 1];
+            if (option == "--worker") {
+                app.run_tile_worker(static_cast<std::uint16_t>(std::stoi(std::string{ value })), info);
+                return 0;
+            } else if (option == "--workers") {
+                // Tiles only come out the same on the workers if on_frame doesn't animate the scene.
+                for (auto address : std::views::split(value, ',')) {
+                    info.distribution.workers.emplace_back(std::string_view{ address });
                 }
             }
-        );
+        }
+        auto thread = app.launch_web(8080, info);
     } catch (const std::exception& e) {
         // Print errors to std::cerr if an exception is thrown.
         std::cerr << e.what() << std::endl;
     }
     return 0;
-}
+}
\ No newline at end of file
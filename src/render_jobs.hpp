@@ -0,0 +1,154 @@
+#ifndef GI_BAH8454_RENDER_JOBS
+#define GI_BAH8454_RENDER_JOBS
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "gi/renderer.hpp"
+
+/// @brief A single frame to render: where the camera is, how large the image is and how many samples are taken.
+class RenderRequest {
+public:
+    Camera::Info camera;
+    std::size_t width;
+    std::size_t height;
+    // Samples per light at every hit, the renderer's only source of noise.
+    std::size_t samples;
+
+    /// @brief Identifies the image the request renders, so identical requests can share one render.
+    std::string get_key() const {
+        std::ostringstream key;
+        key << std::setprecision(9) << this->width << ' ' << this->height << ' ' << this->samples;
+        for (const Vector3* vector : { &this->camera.position, &this->camera.center, &this->camera.up }) {
+            key << ' ' << vector->x() << ' ' << vector->y() << ' ' << vector->z();
+        }
+        return key.str();
+    }
+};
+
+/// @brief A bounded queue of single-frame render requests served by a fixed number of workers, each with a renderer of its own.
+/// Requests identical to one queued or rendering are coalesced into it and all get its image.
+template <typename Shaders, RenderableObject... ObjectTypes>
+class RenderJobs {
+public:
+    class Limits {
+    public:
+        // Frames rendered at once, each by a worker thread with its own renderer.
+        std::size_t workers = 1;
+        // Distinct requests waiting for a worker before more are turned away.
+        std::size_t max_queued = 64;
+    };
+
+    // An encoded image, shared by every request it was rendered for, or nullptr if rendering failed.
+    using Image = std::shared_ptr<const std::string>;
+    using Callback = std::function<void(Image)>;
+
+    RenderJobs(const Renderer<Shaders, ObjectTypes...>::Info& renderer_info, const Limits& limits) : renderer_info{ renderer_info }, limits{ limits } {
+        // Frames for requests are rendered at exactly the size asked for.
+        this->renderer_info.dynamic_resolution.enabled = false;
+        for (std::size_t i = 0; i < std::max<std::size_t>(limits.workers, 1); ++i) {
+            this->workers.emplace_back([this](std::stop_token stop_token) { this->work(stop_token); });
+        }
+    }
+
+    RenderJobs(const RenderJobs&) = delete;
+
+    /// @brief Queues a request, or joins an identical one already queued or rendering.
+    /// @param callback Called with the image on a worker thread once it's rendered.
+    /// @return Whether the request was accepted; it isn't if the queue is full.
+    bool submit(const RenderRequest& request, Callback callback) {
+        std::string key = request.get_key();
+        std::scoped_lock lock{ this->mutex };
+        if (auto job = this->jobs.find(key); job != this->jobs.end()) {
+            job->second->callbacks.push_back(std::move(callback));
+            return true;
+        }
+        if (this->queue.size() >= this->limits.max_queued) { return false; }
+        auto job = std::make_shared<Job>(request, key);
+        job->callbacks.push_back(std::move(callback));
+        this->jobs.emplace(key, job);
+        this->queue.push_back(job);
+        this->condition.notify_one();
+        return true;
+    }
+
+private:
+    class Job {
+    public:
+        Job(const RenderRequest& request, const std::string& key) : request{ request }, key{ key } {}
+
+        RenderRequest request;
+        std::string key;
+        std::vector<Callback> callbacks;
+    };
+
+    void work(std::stop_token stop_token) {
+        // Built on the first request and again whenever the size changes, since the frame buffer can't grow.
+        std::optional<Renderer<Shaders, ObjectTypes...>> renderer;
+        while (true) {
+            std::shared_ptr<Job> job;
+            {
+                std::unique_lock lock{ this->mutex };
+                if (!this->condition.wait(lock, stop_token, [this]() { return !this->queue.empty(); })) { return; }
+                job = std::move(this->queue.front());
+                this->queue.pop_front();
+            }
+            const RenderRequest& request = job->request;
+            Image image;
+            try {
+                if (!renderer || renderer->frame_buffer.output_width != request.width || renderer->frame_buffer.output_height != request.height) {
+                    typename Renderer<Shaders, ObjectTypes...>::Info info = this->renderer_info;
+                    info.frame_buffer = { .width = request.width, .height = request.height };
+                    info.camera = request.camera;
+                    renderer.reset();
+                    renderer.emplace(info);
+                }
+                renderer->camera.look_at(request.camera.position, request.camera.center, request.camera.up);
+                renderer->light_samples = request.samples;
+                // Not render, whose on_frame would animate the scene and time the request as if it were a live frame.
+                renderer->render_still();
+                image = std::make_shared<const std::string>(renderer->frame_buffer.encode_png());
+            } catch (const std::exception& exception) {
+                std::cerr << "Render request failed: " << exception.what() << std::endl;
+                renderer.reset();
+            }
+            // Requests arriving from now on get a render of their own.
+            std::vector<Callback> callbacks;
+            {
+                std::scoped_lock lock{ this->mutex };
+                this->jobs.erase(job->key);
+                callbacks = std::move(job->callbacks);
+            }
+            for (const Callback& callback : callbacks) {
+                callback(image);
+            }
+        }
+    }
+
+    Renderer<Shaders, ObjectTypes...>::Info renderer_info;
+    Limits limits;
+
+    std::mutex mutex;
+    std::condition_variable_any condition;
+    // Jobs waiting for a worker, oldest first.
+    std::deque<std::shared_ptr<Job>> queue;
+    // Jobs queued or rendering by key, for coalescing.
+    std::unordered_map<std::string, std::shared_ptr<Job>> jobs;
+    // Last, so the workers stop before the rest is destroyed.
+    std::vector<std::jthread> workers;
+};
+
+#endif
\ No newline at end of file
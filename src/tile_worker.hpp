@@ -0,0 +1,132 @@
+#ifndef GI_BAH8454_TILE_WORKER
+#define GI_BAH8454_TILE_WORKER
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "gi/renderer.hpp"
+
+/// @brief Draws tiles for coordinators (see TileCoordinator) connecting over TCP, with a copy of the scene built by renderer_info's on_load.
+/// Every connection is served by a thread of its own, taking turns on one renderer.  Tiles come out the same as if the coordinator drew them, as long as the scene doesn't animate.
+template <typename Shaders, RenderableObject... ObjectTypes>
+class TileWorker {
+public:
+    TileWorker(std::uint16_t port, const Renderer<Shaders, ObjectTypes...>::Info& renderer_info) :
+        acceptor{ this->io_context, boost::asio::ip::tcp::endpoint{ boost::asio::ip::tcp::v4(), port } },
+        renderer_info{ renderer_info }
+    {
+        // A worker draws its tiles itself, at whatever size the coordinator asks for.
+        this->renderer_info.distribution.workers.clear();
+        this->renderer_info.dynamic_resolution.enabled = false;
+    }
+
+    TileWorker(const TileWorker&) = delete;
+
+    /// @brief Accepts coordinators until the process ends.
+    void run() {
+        std::cout << "Drawing tiles on port " << this->acceptor.local_endpoint().port() << std::endl;
+        while (true) {
+            boost::asio::ip::tcp::socket socket{ this->io_context };
+            boost::system::error_code error;
+            this->acceptor.accept(socket, error);
+            if (error) {
+                std::cerr << "Accept failed: " << error.message() << std::endl;
+                continue;
+            }
+            std::thread{ [this, socket = std::move(socket)]() mutable { this->serve(socket); } }.detach();
+        }
+    }
+
+private:
+    // The largest frame side a coordinator may ask for, so a bad message can't make the worker allocate without bound.
+    static constexpr std::uint32_t max_frame_size = 8192;
+
+    void serve(boost::asio::ip::tcp::socket& socket) {
+        socket.set_option(boost::asio::ip::tcp::no_delay{ true });
+        std::vector<Vector3> radiance;
+        try {
+            while (true) {
+                TileJob job;
+                boost::asio::read(socket, boost::asio::buffer(&job, sizeof(TileJob)));
+                TileWorker::validate(job);
+                const Tile& tile = job.tile;
+                radiance.resize(static_cast<std::size_t>(tile.width) * tile.height);
+                {
+                    std::scoped_lock lock{ this->mutex };
+                    Renderer<Shaders, ObjectTypes...>& renderer = this->get_renderer(job);
+                    // The scene only moves into camera coordinates again when the camera moved.
+                    bool prepare = this->prepared_view != job.view;
+                    if (prepare) {
+                        *renderer.camera.view = Eigen::Map<const Matrix3H>{ job.view.data() };
+                        this->prepared_view = job.view;
+                    }
+                    renderer.draw_tiles({ tile }, job.frame_index, prepare);
+                    for (std::uint32_t y = 0; y < tile.height; ++y) {
+                        const Vector3* row = renderer.frame_buffer.pixels + (tile.y + y) * renderer.frame_buffer.width + tile.x;
+                        std::copy_n(row, tile.width, radiance.data() + y * tile.width);
+                    }
+                }
+                TileResult result{ job.id, tile };
+                std::array<boost::asio::const_buffer, 2> buffers{
+                    boost::asio::buffer(&result, sizeof(TileResult)),
+                    boost::asio::buffer(radiance.data(), radiance.size() * sizeof(Vector3))
+                };
+                boost::asio::write(socket, buffers);
+            }
+        } catch (const std::exception& exception) {
+            // The coordinator went away, or sent something that isn't a tile.
+            std::cout << "Coordinator disconnected: " << exception.what() << std::endl;
+        }
+    }
+
+    /// @brief Throws unless the job's sizes make sense, before any of them is used to allocate or index.
+    static void validate(const TileJob& job) {
+        if (job.output_width == 0 || job.output_height == 0 || job.output_width > max_frame_size || job.output_height > max_frame_size) {
+            throw std::runtime_error{ "Frame size out of range." };
+        }
+        if (job.width == 0 || job.height == 0 || job.width > job.output_width || job.height > job.output_height) {
+            throw std::runtime_error{ "Drawing size out of range." };
+        }
+        // Subtracted rather than added, so a huge tile can't wrap around to look inside.
+        const Tile& tile = job.tile;
+        if (tile.x > job.width || tile.width > job.width - tile.x || tile.y > job.height || tile.height > job.height - tile.y) {
+            throw std::runtime_error{ "Tile outside of the frame." };
+        }
+    }
+
+    /// @brief The renderer for a job's frame size, built on the first job and again when the output size changes.
+    Renderer<Shaders, ObjectTypes...>& get_renderer(const TileJob& job) {
+        if (!this->renderer || this->renderer->frame_buffer.output_width != job.output_width || this->renderer->frame_buffer.output_height != job.output_height) {
+            typename Renderer<Shaders, ObjectTypes...>::Info info = this->renderer_info;
+            info.frame_buffer = { .width = job.output_width, .height = job.output_height };
+            this->renderer.reset();
+            this->renderer.emplace(info);
+            this->prepared_view.reset();
+        }
+        if (this->renderer->frame_buffer.width != job.width || this->renderer->frame_buffer.height != job.height) {
+            this->renderer->frame_buffer.resize(job.width, job.height);
+            this->renderer->camera.resize(this->renderer->frame_buffer.width, this->renderer->frame_buffer.height);
+        }
+        return *this->renderer;
+    }
+
+    boost::asio::io_context io_context;
+    boost::asio::ip::tcp::acceptor acceptor;
+    Renderer<Shaders, ObjectTypes...>::Info renderer_info;
+
+    std::mutex mutex;
+    std::optional<Renderer<Shaders, ObjectTypes...>> renderer;
+    // The view the scene is in camera coordinates for.
+    std::optional<std::array<Real, 16>> prepared_view;
+};
+
+#endif
\ No newline at end of file
@@ -1,8 +1,20 @@
 #ifndef GI_BAH8454_WEB_SOCKET_SERVER
 #define GI_BAH8454_WEB_SOCKET_SERVER
 
+#include <array>
+#include <charconv>
+#include <chrono>
 #include <cstdint>
+#include <cstring>
+#include <deque>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 
 // Include boost libraries.
 #include <boost/asio.hpp>
@@ -13,107 +25,600 @@ namespace asio = boost::asio;
 namespace beast = boost::beast;
 
 #include "gi/renderer.hpp"
+#include "render_jobs.hpp"
+
+/// @brief How sessions pace the frames they render for their clients.
+class FramePacing {
+public:
+    // Frames per second a session renders at most.
+    Real target_frame_rate = 60;
+    // Frames sent but not yet drawn by the client before a session waits for it.
+    std::size_t max_frames_in_flight = 2;
+    // Render frames while the camera is still, for scenes whose on_frame callback animates them.
+    bool animated = false;
+    // Print each frame's smoothed round trip time and bytes in flight, for debugging.
+    bool log = false;
+};
 
 /// @brief Represents a web socket server, creating sessions when clients connect to the server.
-template <RenderableObject... ObjectTypes>
+/// A pool of threads runs the server's io_context.  Each session's handlers run on its own strand, so sessions render and send in parallel while a session's own handlers never overlap.
+/// Clients connecting to / get a session of their own.  A client connecting to /present gets one too, whose frames are also broadcast to every spectator connected to /watch: they are rendered and encoded once however many watch.
+/// Plain HTTP requests on the same port can ask for single frames: GET /render?position=x,y,z&center=x,y,z&up=x,y,z&width=w&height=h&spp=n returns a PNG, with parameters left out taken from renderer_info.
+template <typename Shaders, RenderableObject... ObjectTypes>
 class WebSocketServer {
 public:
-    WebSocketServer(std::uint16_t port, const Renderer<ObjectTypes...>::Info& renderer_info) :
-        io_context{},
+    /// @param thread_count Threads to run the io_context on.
+    /// @param render_job_limits How many single-frame requests render at once and wait.
+    WebSocketServer(
+        std::uint16_t port, const Renderer<Shaders, ObjectTypes...>::Info& renderer_info, const FramePacing& pacing = {},
+        std::size_t thread_count = std::thread::hardware_concurrency(), const RenderJobs<Shaders, ObjectTypes...>::Limits& render_job_limits = {}
+    ) :
+        thread_count{ std::max<std::size_t>(thread_count, 1) },
+        io_context{ static_cast<int>(this->thread_count) },
         acceptor{ this->io_context, asio::ip::tcp::endpoint{ asio::ip::tcp::v4(), port } },
-        renderer_info{ renderer_info }
+        renderer_info{ renderer_info },
+        pacing{ pacing },
+        render_jobs{ renderer_info, render_job_limits }
     {
         listen();
     }
 
-    /// @brief Calls the internal asio::io_context's run method.
+    /// @brief Runs the internal asio::io_context on the calling thread and thread_count - 1 more until it stops.
     void run() {
+        std::vector<std::jthread> threads;
+        for (std::size_t i = 1; i < this->thread_count; ++i) {
+            threads.emplace_back([this]() { this->io_context.run(); });
+        }
         this->io_context.run();
     }
 
 private:
+    class Connection;
+
     /// @brief Called within the constructor to begin asynchronously listening for new connections.
     void listen() {
-        // Asynchronously listen for a new connection.
-        this->acceptor.async_accept([this](boost::system::error_code error, asio::ip::tcp::socket socket) {
-            // If there hasn't been an error yet, create a new session and start it.
+        // Asynchronously listen for a new connection, giving its socket a strand of its own.
+        this->acceptor.async_accept(asio::make_strand(this->io_context), [this](boost::system::error_code error, asio::ip::tcp::socket socket) {
+            // Continue listening first, so another thread accepts the next connection while this one builds its renderer.
+            this->listen();
+            // If there hasn't been an error yet, find out what the client connected for.
             if (!error) {
-                // This shared pointer won't die until we stop listening for new connections (which will never happen until we kill the program).
-                std::make_shared<Session>(std::move(socket), io_context, this->renderer_info)->start();
+                this->route(std::make_shared<Connection>(std::move(socket)));
             }
-            // Continue listening.
-            this->listen();
         });
     }
 
-    class Session : public std::enable_shared_from_this<Session> {
+    /// @brief Reads the next HTTP request of a connection.  WebSocket upgrades start a session or a spectator depending on their path; other requests are answered and the next one read.
+    void route(std::shared_ptr<Connection> connection) {
+        connection->request = {};
+        beast::http::async_read(connection->socket, connection->buffer, connection->request, [this, connection](boost::system::error_code error, std::size_t) {
+            if (error) { return; }
+            if (!beast::websocket::is_upgrade(connection->request)) {
+                this->respond(connection);
+                return;
+            }
+            // Sessions and spectators keep themselves alive through the handlers they have pending.
+            if (connection->request.target() == "/watch") {
+                std::make_shared<Spectator>(std::move(connection->socket), this->channel)->start(std::move(connection->request));
+            } else {
+                std::shared_ptr<Channel> channel;
+                if (connection->request.target() == "/present") {
+                    // One presenter at a time, or spectators would get the frames of both interleaved.
+                    channel = this->channel.claim();
+                    if (!channel) {
+                        return this->send(connection, beast::http::status::conflict, "Another client is presenting.\n");
+                    }
+                }
+                std::make_shared<Session>(std::move(connection->socket), this->renderer_info, this->pacing, channel)->start(std::move(connection->request));
+            }
+        });
+    }
+
+    /// @brief Answers a plain HTTP request, queueing a render for GET /render.
+    void respond(std::shared_ptr<Connection> connection) {
+        beast::string_view target = connection->request.target();
+        beast::string_view path = target.substr(0, target.find('?'));
+        beast::string_view query = path.size() < target.size() ? target.substr(path.size() + 1) : beast::string_view{};
+        if (path != "/render") {
+            return this->send(connection, beast::http::status::not_found, "Not found.\n");
+        }
+        if (connection->request.method() != beast::http::verb::get) {
+            return this->send(connection, beast::http::status::method_not_allowed, "Only GET renders.\n");
+        }
+        RenderRequest request;
+        try {
+            request = this->parse_render_request(query);
+        } catch (const std::exception& exception) {
+            return this->send(connection, beast::http::status::bad_request, std::string{ exception.what() } + "\n");
+        }
+        bool queued = this->render_jobs.submit(request, [this, connection](RenderJobs<Shaders, ObjectTypes...>::Image image) {
+            // Called on a render worker; respond on the connection's strand.
+            asio::post(connection->socket.get_executor(), [this, connection, image = std::move(image)]() {
+                if (image) {
+                    this->send(connection, beast::http::status::ok, *image, "image/png");
+                } else {
+                    this->send(connection, beast::http::status::internal_server_error, "Rendering failed.\n");
+                }
+            });
+        });
+        if (!queued) {
+            this->send(connection, beast::http::status::service_unavailable, "Too many render requests queued.\n");
+        }
+    }
+
+    /// @brief Writes a response to a connection's request, then reads its next request if it stays open.
+    void send(std::shared_ptr<Connection> connection, beast::http::status status, std::string body, beast::string_view content_type = "text/plain") {
+        beast::http::response<beast::http::string_body>& response = connection->response;
+        response = { status, connection->request.version() };
+        response.set(beast::http::field::content_type, content_type);
+        if (status == beast::http::status::service_unavailable) {
+            response.set(beast::http::field::retry_after, "1");
+        }
+        response.keep_alive(connection->request.keep_alive());
+        response.body() = std::move(body);
+        response.prepare_payload();
+        beast::http::async_write(connection->socket, response, [this, connection](boost::system::error_code error, std::size_t) {
+            if (!error && connection->response.keep_alive()) {
+                this->route(connection);
+            } else {
+                boost::system::error_code ignored;
+                connection->socket.shutdown(asio::ip::tcp::socket::shutdown_send, ignored);
+            }
+        });
+    }
+
+    /// @brief Reads a render request from a query string, falling back on renderer_info for what it leaves out.
+    RenderRequest parse_render_request(beast::string_view query) const {
+        RenderRequest request{
+            .camera = this->renderer_info.camera,
+            .width = this->renderer_info.frame_buffer.width,
+            .height = this->renderer_info.frame_buffer.height,
+            .samples = 1
+        };
+        auto parse_number = [](beast::string_view name, beast::string_view text, auto& number) {
+            auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), number);
+            if (error != std::errc{} || end != text.data() + text.size()) {
+                throw std::invalid_argument{ "Bad value for " + std::string{ name } + ": " + std::string{ text } };
+            }
+        };
+        while (!query.empty()) {
+            beast::string_view parameter = query.substr(0, query.find('&'));
+            query.remove_prefix(std::min(parameter.size() + 1, query.size()));
+            std::size_t equals = parameter.find('=');
+            beast::string_view name = parameter.substr(0, equals);
+            beast::string_view value = equals == beast::string_view::npos ? beast::string_view{} : parameter.substr(equals + 1);
+            if (name == "position" || name == "center" || name == "up") {
+                Vector3& vector = name == "position" ? request.camera.position : name == "center" ? request.camera.center : request.camera.up;
+                for (int i = 0; i < 3; ++i) {
+                    beast::string_view component = value.substr(0, value.find(','));
+                    value.remove_prefix(std::min(component.size() + 1, value.size()));
+                    parse_number(name, component, vector[i]);
+                }
+            } else if (name == "width") {
+                parse_number(name, value, request.width);
+            } else if (name == "height") {
+                parse_number(name, value, request.height);
+            } else if (name == "spp") {
+                parse_number(name, value, request.samples);
+            } else {
+                throw std::invalid_argument{ "Unknown parameter " + std::string{ name } };
+            }
+        }
+        if (request.width == 0 || request.height == 0 || request.width > max_render_size || request.height > max_render_size) {
+            throw std::invalid_argument{ "width and height must be between 1 and " + std::to_string(max_render_size) };
+        }
+        if (request.samples == 0 || request.samples > max_render_samples) {
+            throw std::invalid_argument{ "spp must be between 1 and " + std::to_string(max_render_samples) };
+        }
+        if ((request.camera.center - request.camera.position).cross(request.camera.up).isZero()) {
+            throw std::invalid_argument{ "The camera must look somewhere other than along up" };
+        }
+        return request;
+    }
+
+    // Largest width or height and samples a render request may ask for.
+    static constexpr std::size_t max_render_size = 4096;
+    static constexpr std::size_t max_render_samples = 256;
+
+    /// @brief A connection whose HTTP requests are being read and answered, until it becomes a WebSocket.
+    class Connection {
     public:
-        Session(asio::ip::tcp::socket socket, asio::io_context& io_context, const Renderer<ObjectTypes...>::Info& renderer_info) :
-            ws{ std::move(socket) },
-            io_context{ io_context },
-            renderer{ renderer_info }
-        {}
+        Connection(asio::ip::tcp::socket socket) : socket{ std::move(socket) } {}
+
+        asio::ip::tcp::socket socket;
+        beast::flat_buffer buffer;
+        beast::http::request<beast::http::string_body> request;
+        // Kept alive while it's written.
+        beast::http::response<beast::http::string_body> response;
+    };
 
-        void start() {
-            // Make sure the web socket sends binary frames.
+    class Spectator;
+
+    /// @brief Fans the frames of the presenting session out to the spectators.
+    /// Frames are encoded once into an immutable buffer that every spectator's write shares, and that is freed once the last of them finishes.
+    class Channel {
+    public:
+        using Frame = std::shared_ptr<const std::vector<std::byte>>;
+
+        /// @brief Adds a spectator, sending it the latest frame so it has something to show before the next.
+        void subscribe(const std::shared_ptr<Spectator>& spectator) {
+            std::scoped_lock lock{ this->mutex };
+            this->spectators.push_back(spectator);
+            if (this->latest) {
+                spectator->send(this->latest);
+            }
+        }
+
+        /// @brief Sends a frame to every spectator still connected.
+        void publish(Frame frame) {
+            std::scoped_lock lock{ this->mutex };
+            this->latest = frame;
+            std::erase_if(this->spectators, [](const std::weak_ptr<Spectator>& spectator) { return spectator.expired(); });
+            for (const std::weak_ptr<Spectator>& spectator : this->spectators) {
+                if (std::shared_ptr<Spectator> subscribed = spectator.lock()) {
+                    subscribed->send(frame);
+                }
+            }
+        }
+
+        /// @brief Reserves the channel for a presenting session, unless another one still holds it.
+        /// @return The channel, held until the returned pointer and its copies are gone, or nullptr.
+        std::shared_ptr<Channel> claim() {
+            std::scoped_lock lock{ this->mutex };
+            if (!this->presenter.expired()) { return nullptr; }
+            // The pointer owns nothing but a marker whose lifetime is the claim's.
+            std::shared_ptr<Channel> claim{ std::make_shared<bool>(true), this };
+            this->presenter = claim;
+            // The last presenter's view is no longer current.
+            this->latest = nullptr;
+            return claim;
+        }
+
+    private:
+        // Publishing runs on the presenter's strand and subscribing on the spectators'.
+        std::mutex mutex;
+        // Spectators unsubscribe by going away.
+        std::vector<std::weak_ptr<Spectator>> spectators;
+        Frame latest;
+        // The presenting session's claim.
+        std::weak_ptr<Channel> presenter;
+    };
+
+    /// @brief A client watching the presenting session's frames without a renderer of its own.
+    class Spectator : public std::enable_shared_from_this<Spectator> {
+    public:
+        /// @param socket A socket whose executor is the spectator's strand.
+        Spectator(asio::ip::tcp::socket socket, Channel& channel) : ws{ std::move(socket) }, channel{ channel } {}
+
+        void start(beast::http::request<beast::http::string_body> request) {
             this->ws.binary(true);
-            // Start the session.
-            this->ws.async_accept([self = this->shared_from_this()](boost::system::error_code error) {
+            this->ws.async_accept(request, [self = this->shared_from_this()](boost::system::error_code error) {
                 if (!error) {
-                    self->send_frame();
+                    self->channel.subscribe(self);
                     self->read();
                 }
             });
         }
 
+        /// @brief Sends a frame from any thread.  A spectator still writing an earlier frame skips to the newest once it's done, so a slow one never holds up the others.
+        void send(typename Channel::Frame frame) {
+            asio::post(this->ws.get_executor(), [self = this->shared_from_this(), frame = std::move(frame)]() mutable {
+                self->pending = std::move(frame);
+                if (!self->writing) {
+                    self->write();
+                }
+            });
+        }
+
     private:
+        /// @brief Reads until the client goes away, ignoring its input and acknowledgements: it doesn't control the camera.
         void read() {
             this->ws.async_read(this->buffer, [self = this->shared_from_this()](boost::system::error_code error, std::size_t) {
                 if (!error) {
-                    std::string message = beast::buffers_to_string(self->buffer.data());
-                    if (message == "move_forward") {
-                        self->renderer.camera.translate(self->renderer.camera.get_forward_vector(), -0.01);
-                    }
-                    if (message == "move_backward") {
-                        self->renderer.camera.translate(self->renderer.camera.get_forward_vector(), 0.01);
-                    }
-                    if (message == "move_up") {
-                        self->renderer.camera.translate(self->renderer.camera.get_up_vector(), 0.01);
-                    }
-                    if (message == "move_down") {
-                        self->renderer.camera.translate(self->renderer.camera.get_up_vector(), -0.01);
-                    }
-                    if (message == "move_right") {
-                        self->renderer.camera.translate(self->renderer.camera.get_right_vector(), 0.01);
-                    }
-                    if (message == "move_left") {
-                        self->renderer.camera.translate(self->renderer.camera.get_right_vector(), -0.01);
-                    }
                     self->buffer.clear();
                     self->read();
                 }
             });
         }
 
+        void write() {
+            if (!this->pending || !this->ws.is_open()) { return; }
+            this->writing = true;
+            typename Channel::Frame frame = std::move(this->pending);
+            this->pending = nullptr;
+            // The handler holds the frame, so the buffer outlives the write without being copied.
+            this->ws.async_write(asio::buffer(*frame), [self = this->shared_from_this(), frame](boost::system::error_code error, std::size_t) {
+                self->writing = false;
+                if (!error) {
+                    self->write();
+                }
+            });
+        }
+
+        beast::websocket::stream<asio::ip::tcp::socket> ws;
+        Channel& channel;
+        beast::flat_buffer buffer;
+        // The newest frame not yet written.
+        typename Channel::Frame pending;
+        bool writing = false;
+    };
+
+    class Session : public std::enable_shared_from_this<Session> {
+    public:
+        /// @param socket A socket whose executor is the session's strand.
+        /// @param channel The claimed channel to broadcast frames to, or nullptr.
+        Session(asio::ip::tcp::socket socket, const Renderer<Shaders, ObjectTypes...>::Info& renderer_info, const FramePacing& pacing, std::shared_ptr<Channel> channel) :
+            ws{ std::move(socket) },
+            renderer{ renderer_info },
+            channel{ std::move(channel) },
+            pacing{ pacing },
+            frame_period{ std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<Real>{ 1 / pacing.target_frame_rate }) },
+            timer{ this->ws.get_executor() }
+        {}
+
+        /// @param request The client's upgrade request, already read.
+        void start(beast::http::request<beast::http::string_body> request) {
+            // Everything from here on runs on the strand: handlers of the socket and the timer run on their executor, which is the strand.
+            asio::dispatch(this->ws.get_executor(), [self = this->shared_from_this(), request = std::move(request)]() {
+                // Make sure the web socket sends binary frames.
+                self->ws.binary(true);
+                // Start the session.
+                self->ws.async_accept(request, [self](boost::system::error_code error) {
+                    if (!error) {
+                        self->schedule_frame();
+                        self->read();
+                    }
+                });
+            });
+        }
+
+    private:
+        /// @brief The binary input message web/index.js sends whenever the client's input changes: 16 bytes, little-endian.
+        /// Movement axes are held state and replace the previous message's; look deltas are pixels of mouse movement since the previous message and accumulate until the next frame.
+        class InputMessage {
+        public:
+            // Increases by one per message; older messages are ignored.
+            std::uint32_t sequence;
+            // -1, 0 or 1 along the camera's right, up and forward axes.
+            std::int8_t right;
+            std::int8_t up;
+            std::int8_t forward;
+            std::uint8_t padding;
+            Real look_x;
+            Real look_y;
+        };
+        static_assert(sizeof(InputMessage) == 16 && std::is_trivially_copyable_v<InputMessage>);
+
+        /// @brief The 20-byte little-endian header of every frame sent.
+        /// The RGBA pixels of the whole frame follow, or under partial updates a number of tiles, each a 16-byte Tile followed by its pixels.
+        class FrameHeader {
+        public:
+            // Size of the frame.
+            std::uint32_t width;
+            std::uint32_t height;
+            // Size the frame was rendered at before being upscaled, smaller under dynamic resolution.
+            std::uint32_t render_width;
+            std::uint32_t render_height;
+            // Tiles that follow, or 0 if the whole frame does.
+            std::uint32_t tile_count;
+        };
+        static_assert(sizeof(FrameHeader) == 20 && std::is_trivially_copyable_v<FrameHeader>);
+        static_assert(sizeof(Tile) == 16 && std::is_trivially_copyable_v<Tile>);
+
+        /// @brief The 4-byte message web/index.js sends after drawing each frame.
+        class AckMessage {
+        public:
+            // Frames the client has drawn since it connected.
+            std::uint32_t frame_count;
+        };
+        static_assert(sizeof(AckMessage) == 4 && std::is_trivially_copyable_v<AckMessage>);
+
+        /// @brief The 8-byte message web/index.js sends as the mouse moves: the pixels of the frame to keep up to date under PartialUpdate::Pattern::region, empty to clear them.
+        class RegionMessage {
+        public:
+            std::uint16_t x;
+            std::uint16_t y;
+            std::uint16_t width;
+            std::uint16_t height;
+        };
+        static_assert(sizeof(RegionMessage) == 8 && std::is_trivially_copyable_v<RegionMessage>);
+
+        // Units per second the camera moves and radians it turns per pixel of mouse movement.
+        static constexpr Real movement_speed = 0.6;
+        static constexpr Real look_sensitivity = 0.002;
+
+        void read() {
+            this->ws.async_read(this->buffer, [self = this->shared_from_this()](boost::system::error_code error, std::size_t) {
+                if (error) {
+                    // The client is gone; drop the frame waiting to be rendered for it.
+                    self->timer.cancel();
+                    return;
+                }
+                if (self->ws.got_binary() && self->buffer.size() == sizeof(InputMessage)) {
+                    InputMessage message;
+                    asio::buffer_copy(asio::buffer(&message, sizeof(message)), self->buffer.data());
+                    // Compare with wraparound, so the sequence may overflow.
+                    if (static_cast<std::int32_t>(message.sequence - self->sequence) > 0) {
+                        self->sequence = message.sequence;
+                        Vector3 movement{ static_cast<Real>(message.right), static_cast<Real>(message.up), static_cast<Real>(message.forward) };
+                        if (self->movement.isZero()) {
+                            // Start moving from now rather than from the last frame, which may be long ago.
+                            self->last_input_time = std::chrono::steady_clock::now();
+                        }
+                        self->movement = movement;
+                        self->look += Vector2{ message.look_x, message.look_y };
+                        self->dirty = true;
+                    }
+                } else if (self->ws.got_binary() && self->buffer.size() == sizeof(AckMessage)) {
+                    AckMessage message;
+                    asio::buffer_copy(asio::buffer(&message, sizeof(message)), self->buffer.data());
+                    self->acknowledge(message.frame_count);
+                } else if (self->ws.got_binary() && self->buffer.size() == sizeof(RegionMessage)) {
+                    RegionMessage message;
+                    asio::buffer_copy(asio::buffer(&message, sizeof(message)), self->buffer.data());
+                    self->renderer.partial_update.set_region({ message.x, message.y, message.width, message.height });
+                }
+                self->buffer.clear();
+                self->schedule_frame();
+                self->read();
+            });
+        }
+
+        /// @brief Records frames the client has drawn, measuring the round trip of the last one.
+        void acknowledge(std::uint32_t frame_count) {
+            auto now = std::chrono::steady_clock::now();
+            while (static_cast<std::int32_t>(frame_count - this->frames_drawn) > 0 && !this->send_times.empty()) {
+                Real round_trip_time = std::chrono::duration<Real>{ now - this->send_times.front() }.count();
+                // Smooth like TCP's estimator (RFC 6298).
+                this->round_trip_time = this->round_trip_time == 0 ? round_trip_time : 0.875_r * this->round_trip_time + 0.125_r * round_trip_time;
+                this->send_times.pop_front();
+                ++this->frames_drawn;
+            }
+        }
+
+        /// @brief Renders the next frame once the pacing allows it: no earlier than a frame period after the last, only while the client keeps up, and only if the camera moved, the scene is animated or tiles left out of partial updates remain to be drawn.
+        /// Idle sessions render nothing until input arrives.
+        void schedule_frame() {
+            if (this->frame_scheduled || !this->ws.is_open()) { return; }
+            bool changed = this->dirty || !this->movement.isZero() || this->pacing.animated || this->stale;
+            if (!changed || this->send_times.size() >= this->pacing.max_frames_in_flight) { return; }
+            this->frame_scheduled = true;
+            this->timer.expires_at(this->next_frame_time);
+            this->timer.async_wait([self = this->shared_from_this()](boost::system::error_code error) {
+                if (!error) {
+                    self->send_frame();
+                }
+            });
+        }
+
+        /// @brief Moves and turns the camera by the input received since the last frame, scaled by the time since then.
+        void apply_input() {
+            auto now = std::chrono::steady_clock::now();
+            Real delta = std::chrono::duration<Real>{ now - this->last_input_time }.count();
+            this->last_input_time = now;
+            Camera& camera = this->renderer.camera;
+            // The camera looks towards -Z in camera coordinates.
+            Vector3 direction{ this->movement.x(), this->movement.y(), -this->movement.z() };
+            if (!direction.isZero()) {
+                camera.translate(direction.normalized(), movement_speed * delta);
+            }
+            if (!this->look.isZero()) {
+                // Moving the mouse down looks down.
+                camera.rotate(this->look.x() * look_sensitivity, -this->look.y() * look_sensitivity);
+                this->look = { 0, 0 };
+            }
+        }
+
         void send_frame() {
-            this->ws.async_write(asio::buffer(this->renderer.frame_buffer.get_bytes()), [this](boost::system::error_code error, std::size_t) {
+            this->next_frame_time = std::chrono::steady_clock::now() + this->frame_period;
+            bool changed = this->dirty || !this->movement.isZero() || this->pacing.animated;
+            this->dirty = false;
+            this->apply_input();
+            FrameBuffer& frame_buffer = this->renderer.frame_buffer;
+            // While the view changes, redraw only some tiles of a frame the client already has whole.
+            // Not when the last frame was upscaled or this one will be, since tiles are in pixels of the render size; and not for spectators, who skip frames.
+            std::vector<Tile> tiles;
+            bool same_size = !frame_buffer.upscaled && frame_buffer.width == frame_buffer.output_width && frame_buffer.height == frame_buffer.output_height;
+            if (changed && this->has_frame && same_size && this->channel == nullptr) {
+                tiles = this->renderer.partial_update.get_tiles(frame_buffer.width, frame_buffer.height, this->partial_frames++);
+            }
+            this->renderer.render(tiles);
+            // The tiles left out are stale until the view settles and a whole frame is drawn.
+            this->stale = !tiles.empty();
+            this->has_frame = true;
+            this->frame_header = {
+                .width = static_cast<std::uint32_t>(frame_buffer.output_width),
+                .height = static_cast<std::uint32_t>(frame_buffer.output_height),
+                .render_width = static_cast<std::uint32_t>(frame_buffer.width),
+                .render_height = static_cast<std::uint32_t>(frame_buffer.height),
+                .tile_count = static_cast<std::uint32_t>(tiles.size())
+            };
+            std::array<asio::const_buffer, 2> frame{ asio::buffer(&this->frame_header, sizeof(this->frame_header)), asio::buffer(this->renderer.frame_buffer.get_bytes()) };
+            if (!tiles.empty()) {
+                // Gather the rows of every tile behind its coordinates.
+                std::span<const std::byte> bytes = frame_buffer.get_bytes();
+                this->tile_bytes.clear();
+                for (const Tile& tile : tiles) {
+                    const auto* header = reinterpret_cast<const std::byte*>(&tile);
+                    this->tile_bytes.insert(this->tile_bytes.end(), header, header + sizeof(tile));
+                    for (std::size_t y = tile.y; y < tile.y + tile.height; ++y) {
+                        auto row = bytes.begin() + (y * frame_buffer.output_width + tile.x) * sizeof(Pixel);
+                        this->tile_bytes.insert(this->tile_bytes.end(), row, row + tile.width * sizeof(Pixel));
+                    }
+                }
+                frame[1] = asio::buffer(this->tile_bytes);
+            }
+            if (this->channel != nullptr) {
+                // Encode the frame once for all spectators; the next render overwrites the frame buffer while they may still be writing it.
+                // Published even with no one watching, so spectators joining while the presenter is idle get the current frame.
+                auto encoded = std::make_shared<std::vector<std::byte>>(asio::buffer_size(frame));
+                asio::buffer_copy(asio::buffer(*encoded), frame);
+                this->channel->publish(std::move(encoded));
+            }
+            if (this->pacing.log) {
+                // One write, so lines of sessions on other threads don't interleave.
+                std::ostringstream line;
+                line << "Frame pacing: " << this->round_trip_time * 1000 << " ms round trip, "
+                    << (this->send_times.size() + 1) * asio::buffer_size(frame) << " bytes in flight\n";
+                std::cout << line.str() << std::flush;
+            }
+            this->send_times.push_back(std::chrono::steady_clock::now());
+            this->ws.async_write(frame, [self = this->shared_from_this()](boost::system::error_code error, std::size_t) {
+                // Only one write may be outstanding, so the next frame waits for this one to leave.
+                self->frame_scheduled = false;
                 if (!error) {
-                    this->renderer.render();
-                    this->send_frame();
+                    self->schedule_frame();
                 }
             });
         }
 
         beast::websocket::stream<asio::ip::tcp::socket> ws;
-        asio::io_context& io_context;
-        Renderer<ObjectTypes...> renderer;
+        Renderer<Shaders, ObjectTypes...> renderer;
+        // Where frames are broadcast to spectators if this session presents, claimed for as long as the session lives.
+        std::shared_ptr<Channel> channel;
 
         beast::multi_buffer buffer;
+        // Kept alive while the frame it heads is written.
+        FrameHeader frame_header;
+        // The tiles of a partial update, kept alive while they're written.
+        std::vector<std::byte> tile_bytes;
+        // Whether the client has been sent a whole frame, and whether tiles left out since are out of date.
+        bool has_frame = false;
+        bool stale = false;
+        // Partial updates sent, alternating the tiles they draw.
+        std::uint32_t partial_frames = 0;
+
+        // Input state from the client.
+        std::uint32_t sequence = 0;
+        Vector3 movement{ 0, 0, 0 };
+        Vector2 look{ 0, 0 };
+        std::chrono::steady_clock::time_point last_input_time = std::chrono::steady_clock::now();
+        // Whether input arrived since the last frame.
+        bool dirty = true;
+
+        // Frame pacing.
+        FramePacing pacing;
+        std::chrono::steady_clock::duration frame_period;
+        asio::steady_timer timer;
+        // Whether a frame is waiting on the timer or being written.
+        bool frame_scheduled = false;
+        std::chrono::steady_clock::time_point next_frame_time = std::chrono::steady_clock::now();
+        // When each frame the client hasn't drawn yet was sent.
+        std::deque<std::chrono::steady_clock::time_point> send_times;
+        std::uint32_t frames_drawn = 0;
+        // Smoothed seconds from sending a frame to the client drawing it.
+        Real round_trip_time = 0;
     };
 
+    std::size_t thread_count;
     asio::io_context io_context;
     asio::ip::tcp::acceptor acceptor;
-    Renderer<ObjectTypes...>::Info renderer_info;
+    Renderer<Shaders, ObjectTypes...>::Info renderer_info;
+    FramePacing pacing;
+    // Frames of the session presenting, for spectators.
+    Channel channel;
+    // Last, so its workers stop before the rest is destroyed.
+    RenderJobs<Shaders, ObjectTypes...> render_jobs;
 };
 
 #endif
\ No newline at end of file
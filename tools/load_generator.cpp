@@ -0,0 +1,393 @@
+// Opens many WebSocket connections to the gi server, replays scripted camera input on each like web/index.js would, and reports how fast connections open and frames come back.
+//
+// gi_load [--host 127.0.0.1] [--port 8080] [--path /] [--clients 8] [--seconds 10] [--threads 1] [--script file]
+//
+// A script has one step per line: seconds right up forward look_x look_y, where the axes are -1, 0 or 1 and look is pixels of mouse movement per second.
+// Steps play in a loop.  Lines starting with # are ignored.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Include boost libraries.
+#include <boost/asio.hpp>
+#include <boost/beast.hpp>
+#include <boost/beast/websocket.hpp>
+// Simplify boost namespaces.
+namespace asio = boost::asio;
+namespace beast = boost::beast;
+
+using Clock = std::chrono::steady_clock;
+
+// The server's messages (see WebSocketServer::Session).
+
+class InputMessage {
+public:
+    std::uint32_t sequence;
+    std::int8_t right;
+    std::int8_t up;
+    std::int8_t forward;
+    std::uint8_t padding;
+    float look_x;
+    float look_y;
+};
+static_assert(sizeof(InputMessage) == 16);
+
+class FrameHeader {
+public:
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t render_width;
+    std::uint32_t render_height;
+    std::uint32_t tile_count;
+};
+static_assert(sizeof(FrameHeader) == 20);
+
+/// @brief One step of camera input held for a while.
+class Step {
+public:
+    double seconds;
+    std::int8_t right;
+    std::int8_t up;
+    std::int8_t forward;
+    // Pixels of mouse movement per second.
+    float look_x;
+    float look_y;
+};
+
+/// @brief Walks forward, looks around, strafes and rests, so the server sees both moving and idle clients.
+const std::vector<Step> default_script{
+    { 2, 0, 0, 1, 0, 0 },
+    { 2, 0, 0, 0, 200, 0 },
+    { 1, 1, 0, 0, 0, 0 },
+    { 1, -1, 0, 0, 0, 50 },
+    { 1, 0, 0, 0, 0, 0 },
+    { 1, 0, 0, -1, -200, -50 }
+};
+
+std::vector<Step> load_script(const std::string& path) {
+    std::ifstream file{ path };
+    if (!file) {
+        throw std::runtime_error{ "Could not open " + path };
+    }
+    std::vector<Step> script;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') { continue; }
+        std::istringstream words{ line };
+        int right, up, forward;
+        Step step;
+        if (!(words >> step.seconds >> right >> up >> forward >> step.look_x >> step.look_y) || step.seconds <= 0) {
+            throw std::runtime_error{ "Bad script line: " + line };
+        }
+        step.right = static_cast<std::int8_t>(std::clamp(right, -1, 1));
+        step.up = static_cast<std::int8_t>(std::clamp(up, -1, 1));
+        step.forward = static_cast<std::int8_t>(std::clamp(forward, -1, 1));
+        script.push_back(step);
+    }
+    if (script.empty()) {
+        throw std::runtime_error{ path + " has no steps" };
+    }
+    return script;
+}
+
+/// @brief The step of a looping script at a time since it started.
+const Step& get_step(const std::vector<Step>& script, double time) {
+    double length = 0;
+    for (const Step& step : script) {
+        length += step.seconds;
+    }
+    time = std::fmod(time, length);
+    for (const Step& step : script) {
+        if (time < step.seconds) { return step; }
+        time -= step.seconds;
+    }
+    return script.back();
+}
+
+/// @brief The value below which a fraction of the samples lie, or 0 without samples.
+double get_percentile(std::vector<double> samples, double fraction) {
+    if (samples.empty()) { return 0; }
+    std::size_t index = std::min(static_cast<std::size_t>(fraction * samples.size()), samples.size() - 1);
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index];
+}
+
+/// @brief One simulated viewer: sends input at most once per display refresh while it changes, acknowledges every frame, and measures what comes back.
+class Client : public std::enable_shared_from_this<Client> {
+public:
+    Client(asio::io_context& io_context, const std::vector<Step>& script, double script_offset) :
+        ws{ asio::make_strand(io_context) },
+        timer{ this->ws.get_executor() },
+        script{ script },
+        script_offset{ script_offset }
+    {}
+
+    void start(const asio::ip::tcp::resolver::results_type& endpoints, const std::string& host, const std::string& path) {
+        this->launch_time = Clock::now();
+        asio::async_connect(this->ws.next_layer(), endpoints, [self = this->shared_from_this(), host, path](boost::system::error_code error, const asio::ip::tcp::endpoint&) {
+            if (error) { return self->fail("connect", error); }
+            auto connect_time = Clock::now();
+            self->connect_seconds = std::chrono::duration<double>{ connect_time - self->launch_time }.count();
+            self->ws.async_handshake(host, path, [self, connect_time](boost::system::error_code error) {
+                if (error) { return self->fail("handshake", error); }
+                self->ws.binary(true);
+                self->start_time = Clock::now();
+                self->handshake_seconds = std::chrono::duration<double>{ self->start_time - connect_time }.count();
+                self->connected = true;
+                self->tick();
+                self->read();
+            });
+        });
+    }
+
+    /// @brief Stops sending and reading, keeping the measurements.
+    void stop() {
+        asio::post(this->ws.get_executor(), [self = this->shared_from_this()]() {
+            self->end_time = Clock::now();
+            self->timer.cancel();
+            beast::get_lowest_layer(self->ws).close();
+        });
+    }
+
+    void report(std::size_t index) const {
+        double seconds = std::chrono::duration<double>{ this->end_time - this->start_time }.count();
+        if (!this->connected || seconds <= 0) {
+            std::cout << std::setw(6) << index << "  not connected" << std::endl;
+            return;
+        }
+        std::cout << std::setw(6) << index
+            << std::setw(9) << this->frame_count / seconds
+            << std::setw(11) << this->bytes / seconds / 1e6
+            << std::setw(9) << get_percentile(this->latencies, 0.5) * 1000
+            << std::setw(9) << get_percentile(this->latencies, 0.95) * 1000
+            << std::setw(9) << get_percentile(this->latencies, 0.99) * 1000
+            << std::setw(9) << get_percentile(this->intervals, 0.99) * 1000
+            << std::setw(9) << this->connect_seconds * 1000
+            << std::setw(9) << this->handshake_seconds * 1000
+            << "  " << this->width << "x" << this->height << std::endl;
+    }
+
+    bool connected = false;
+    std::uint32_t frame_count = 0;
+    std::size_t bytes = 0;
+    // When start was called, before connecting.
+    Clock::time_point launch_time;
+    // Seconds to open the TCP connection, and then to complete the WebSocket handshake.
+    double connect_seconds = 0;
+    double handshake_seconds = 0;
+    // When the handshake completed and input began.
+    Clock::time_point start_time;
+    Clock::time_point end_time;
+    // Seconds from sending input to receiving the first frame after it.
+    std::vector<double> latencies;
+    // Seconds between consecutive frames.
+    std::vector<double> intervals;
+
+private:
+    // Input is sampled at a typical display refresh rate, as requestAnimationFrame would.
+    static constexpr std::chrono::microseconds input_period{ 16667 };
+
+    void fail(const char* what, boost::system::error_code error) {
+        std::cerr << what << ": " << error.message() << std::endl;
+    }
+
+    /// @brief Sends the script's input for now if it changed since the last message.
+    void tick() {
+        auto now = Clock::now();
+        double time = std::chrono::duration<double>{ now - this->start_time }.count();
+        double delta = std::chrono::duration<double>{ now - this->last_tick }.count();
+        this->last_tick = now;
+        const Step& step = get_step(this->script, time + this->script_offset);
+        float look_x = static_cast<float>(step.look_x * delta);
+        float look_y = static_cast<float>(step.look_y * delta);
+        bool moved = step.right != this->last_input.right || step.up != this->last_input.up || step.forward != this->last_input.forward;
+        if (this->sequence == 0 || moved || look_x != 0 || look_y != 0) {
+            InputMessage message{ ++this->sequence, step.right, step.up, step.forward, 0, look_x, look_y };
+            this->last_input = message;
+            this->send(&message, sizeof(message));
+            // Only the oldest input still waiting for a frame counts, like the delay a user notices.
+            if (!this->input_time) {
+                this->input_time = now;
+            }
+        }
+        this->timer.expires_after(input_period);
+        this->timer.async_wait([self = this->shared_from_this()](boost::system::error_code error) {
+            if (!error) {
+                self->tick();
+            }
+        });
+    }
+
+    void read() {
+        this->ws.async_read(this->buffer, [self = this->shared_from_this()](boost::system::error_code error, std::size_t size) {
+            if (error) { return; }
+            auto now = Clock::now();
+            if (size >= sizeof(FrameHeader)) {
+                FrameHeader header;
+                asio::buffer_copy(asio::buffer(&header, sizeof(header)), self->buffer.data());
+                self->width = header.width;
+                self->height = header.height;
+            }
+            self->buffer.consume(size);
+            if (self->frame_count > 0) {
+                self->intervals.push_back(std::chrono::duration<double>{ now - self->last_frame_time }.count());
+            }
+            if (self->input_time) {
+                self->latencies.push_back(std::chrono::duration<double>{ now - *self->input_time }.count());
+                self->input_time.reset();
+            }
+            self->last_frame_time = now;
+            self->bytes += size;
+            ++self->frame_count;
+            // Acknowledge the frame, as web/index.js does once it has drawn it.
+            self->send(&self->frame_count, sizeof(self->frame_count));
+            self->read();
+        });
+    }
+
+    /// @brief Queues a binary message; only one write may be outstanding.
+    void send(const void* data, std::size_t size) {
+        const auto* bytes = static_cast<const std::byte*>(data);
+        this->writes.emplace_back(bytes, bytes + size);
+        if (this->writes.size() == 1) {
+            this->write();
+        }
+    }
+
+    void write() {
+        this->ws.async_write(asio::buffer(this->writes.front()), [self = this->shared_from_this()](boost::system::error_code error, std::size_t) {
+            self->writes.pop_front();
+            if (!error && !self->writes.empty()) {
+                self->write();
+            }
+        });
+    }
+
+    beast::websocket::stream<asio::ip::tcp::socket> ws;
+    asio::steady_timer timer;
+    beast::flat_buffer buffer;
+    std::deque<std::vector<std::byte>> writes;
+
+    const std::vector<Step>& script;
+    // Seconds into the script this client starts, so clients don't all move in lockstep.
+    double script_offset;
+    std::uint32_t sequence = 0;
+    InputMessage last_input{};
+    Clock::time_point last_tick = Clock::now();
+    std::optional<Clock::time_point> input_time;
+
+    Clock::time_point last_frame_time;
+    std::uint32_t width = 0;
+    std::uint32_t height = 0;
+};
+
+int main(int argc, char** argv) {
+    std::string host = "127.0.0.1";
+    std::string port = "8080";
+    std::string path = "/";
+    std::size_t client_count = 8;
+    double seconds = 10;
+    std::size_t thread_count = 1;
+    std::vector<Step> script = default_script;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string option = argv[i];
+            if (i + 1 >= argc) {
+                throw std::runtime_error{ "Missing value for " + option };
+            }
+            std::string value = argv[++i];
+            if (option == "--host") { host = value; }
+            else if (option == "--port") { port = value; }
+            else if (option == "--path") { path = value; }
+            else if (option == "--clients") { client_count = std::stoul(value); }
+            else if (option == "--seconds") { seconds = std::stod(value); }
+            else if (option == "--threads") { thread_count = std::max<std::size_t>(std::stoul(value), 1); }
+            else if (option == "--script") { script = load_script(value); }
+            else { throw std::runtime_error{ "Unknown option " + option }; }
+        }
+    } catch (const std::exception& exception) {
+        std::cerr << exception.what() << std::endl;
+        std::cerr << "Usage: gi_load [--host 127.0.0.1] [--port 8080] [--path /] [--clients 8] [--seconds 10] [--threads 1] [--script file]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    asio::io_context io_context{ static_cast<int>(thread_count) };
+    auto endpoints = asio::ip::tcp::resolver{ io_context }.resolve(host, port);
+    std::vector<std::shared_ptr<Client>> clients;
+    auto launch_time = Clock::now();
+    for (std::size_t i = 0; i < client_count; ++i) {
+        clients.push_back(std::make_shared<Client>(io_context, script, 0.37 * i));
+        clients.back()->start(endpoints, host, path);
+    }
+
+    // Stop every client once the time is up; their handlers then finish and run() returns.
+    asio::steady_timer deadline{ io_context, std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>{ seconds }) };
+    deadline.async_wait([&clients](boost::system::error_code) {
+        for (const std::shared_ptr<Client>& client : clients) {
+            client->stop();
+        }
+    });
+    std::vector<std::jthread> threads;
+    for (std::size_t i = 1; i < thread_count; ++i) {
+        threads.emplace_back([&io_context]() { io_context.run(); });
+    }
+    io_context.run();
+    threads.clear();
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "client      fps    MB/s   p50 ms   p95 ms   p99 ms  gap p99  conn ms    hs ms  size" << std::endl;
+    double total_fps = 0;
+    double total_bytes = 0;
+    std::vector<double> latencies;
+    std::vector<double> connect_latencies;
+    std::vector<double> handshake_latencies;
+    std::size_t connected_count = 0;
+    Clock::time_point last_connected_time = launch_time;
+    for (std::size_t i = 0; i < clients.size(); ++i) {
+        const Client& client = *clients[i];
+        client.report(i);
+        double client_seconds = std::chrono::duration<double>{ client.end_time - client.start_time }.count();
+        if (client.connected && client_seconds > 0) {
+            total_fps += client.frame_count / client_seconds;
+            total_bytes += client.bytes / client_seconds;
+            latencies.insert(latencies.end(), client.latencies.begin(), client.latencies.end());
+        }
+        if (client.connected) {
+            connect_latencies.push_back(client.connect_seconds);
+            handshake_latencies.push_back(client.handshake_seconds);
+            last_connected_time = std::max(last_connected_time, client.start_time);
+            ++connected_count;
+        }
+    }
+    std::cout << "all   " << std::setw(9) << total_fps << std::setw(11) << total_bytes / 1e6
+        << std::setw(9) << get_percentile(latencies, 0.5) * 1000
+        << std::setw(9) << get_percentile(latencies, 0.95) * 1000
+        << std::setw(9) << get_percentile(latencies, 0.99) * 1000 << std::endl;
+    // Clients all connect at once, so the rate is how fast the server takes on a burst of new viewers.
+    double connect_seconds = std::chrono::duration<double>{ last_connected_time - launch_time }.count();
+    std::cout << "connected " << connected_count << " of " << clients.size() << " clients";
+    if (connected_count > 0 && connect_seconds > 0) {
+        std::cout << " at " << connected_count / connect_seconds << " per second";
+    }
+    std::cout << std::endl;
+    std::cout << "connect   p50 ms " << get_percentile(connect_latencies, 0.5) * 1000 << "  p99 ms " << get_percentile(connect_latencies, 0.99) * 1000 << std::endl;
+    std::cout << "handshake p50 ms " << get_percentile(handshake_latencies, 0.5) * 1000 << "  p99 ms " << get_percentile(handshake_latencies, 0.99) * 1000 << std::endl;
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
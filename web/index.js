@@ -3,8 +3,10 @@ window.onload = function () {
     // Obtain a handle to the canvas.
     const canvasElement = document.getElementById("frame");
     const canvas = canvasElement.getContext("2d");
-    // Create a new connection to a web socket server.
-    socket = new WebSocket("ws://localhost:8080");
+    // Create a new connection to a web socket server: index.html?present broadcasts the view to index.html?watch, which only watches it.
+    const query = new URLSearchParams(window.location.search);
+    const path = query.has("watch") ? "/watch" : query.has("present") ? "/present" : "/";
+    socket = new WebSocket("ws://localhost:8080" + path);
     socket.binaryType = "arraybuffer";
     // Event listener to be called upon every connection event.
     socket.addEventListener('open', (event) => {
@@ -19,58 +21,137 @@ window.onload = function () {
         console.error('Error from web socket server:', event);
     });
     // Event listener to be called every time a message is received from the web socket server.
+    const ack = new DataView(new ArrayBuffer(4));
+    let framesDrawn = 0;
+    const resolutionElement = document.getElementById("resolution");
     socket.addEventListener('message', (event) => {
-        // Draw the frame onto the canvas.
-        const frameBuffer = new Uint8ClampedArray(event.data);
-        const imageData = new ImageData(frameBuffer, canvasElement.width, canvasElement.height);
-        canvas.putImageData(imageData, 0, 0);
-    });
-    // Add keyboard controls.
-    let currentActions = new Set()
-    document.addEventListener('keydown', (e) => {
-        if (e.code == "KeyW" || e.key == "ArrowUp") {
-            currentActions.add("move_forward");
-        }
-        if (e.code == "KeyS" || e.key == "ArrowDown") {
-            currentActions.add("move_backward");
-        }
-        if (e.code == "KeyA" || e.key == "ArrowLeft") {
-            currentActions.add("move_left");
+        // Read the frame's header (see WebSocketServer::Session::FrameHeader).
+        const header = new DataView(event.data, 0, 20);
+        const width = header.getUint32(0, true);
+        const height = header.getUint32(4, true);
+        const renderWidth = header.getUint32(8, true);
+        const renderHeight = header.getUint32(12, true);
+        const tileCount = header.getUint32(16, true);
+        if (canvasElement.width != width || canvasElement.height != height) {
+            canvasElement.width = width;
+            canvasElement.height = height;
         }
-        if (e.code == "KeyD" || e.key == "ArrowRight") {
-            currentActions.add("move_right");
+        resolutionElement.textContent = `Rendering at ${renderWidth}x${renderHeight}, shown at ${width}x${height}`;
+        if (tileCount == 0) {
+            // Draw the whole frame onto the canvas.
+            const frameBuffer = new Uint8ClampedArray(event.data, 20);
+            const imageData = new ImageData(frameBuffer, width, height);
+            canvas.putImageData(imageData, 0, 0);
+        } else {
+            // Draw each updated tile over the previous frame: its position and size, then its pixels.
+            let offset = 20;
+            for (let i = 0; i < tileCount; ++i) {
+                const tile = new DataView(event.data, offset, 16);
+                const x = tile.getUint32(0, true);
+                const y = tile.getUint32(4, true);
+                const tileWidth = tile.getUint32(8, true);
+                const tileHeight = tile.getUint32(12, true);
+                const pixels = new Uint8ClampedArray(event.data, offset + 16, tileWidth * tileHeight * 4);
+                canvas.putImageData(new ImageData(pixels, tileWidth, tileHeight), x, y);
+                offset += 16 + pixels.length;
+            }
         }
-        if (e.code == "Space") {
-            currentActions.add("move_up");
-        }
-        if (e.code == "ShiftLeft") {
-            currentActions.add("move_down");
+        // Tell the server the frame was drawn, so it sends the next one only as fast as this client keeps up.
+        ack.setUint32(0, ++framesDrawn, true);
+        socket.send(ack.buffer);
+    });
+    // Input state, sent as one binary message (see WebSocketServer::Session::InputMessage) whenever it changes, at most once per animation frame.
+    // The server holds the movement axes between messages and applies them every frame it renders, scaled by its frame time.
+    const keyAxes = {
+        KeyW: [2, 1], ArrowUp: [2, 1],
+        KeyS: [2, -1], ArrowDown: [2, -1],
+        KeyD: [0, 1], ArrowRight: [0, 1],
+        KeyA: [0, -1], ArrowLeft: [0, -1],
+        Space: [1, 1],
+        ShiftLeft: [1, -1]
+    };
+    const heldKeys = new Set();
+    let look = [0, 0];
+    let sequence = 0;
+    let changed = false;
+    document.addEventListener('keydown', (e) => {
+        if (e.code in keyAxes && !heldKeys.has(e.code)) {
+            heldKeys.add(e.code);
+            changed = true;
         }
     });
     document.addEventListener('keyup', (e) => {
-        if (e.code == "KeyW" || e.key == "ArrowUp") {
-            currentActions.delete("move_forward");
+        if (heldKeys.delete(e.code)) {
+            changed = true;
         }
-        if (e.code == "KeyS" || e.key == "ArrowDown") {
-            currentActions.delete("move_backward");
+    });
+    // Keys released while the page is in the background never send keyup.
+    window.addEventListener('blur', () => {
+        if (heldKeys.size > 0) {
+            heldKeys.clear();
+            changed = true;
         }
-        if (e.code == "KeyA" || e.key == "ArrowLeft") {
-            currentActions.delete("move_left");
+    });
+    // Look around with the mouse while the pointer is locked to the canvas.
+    canvasElement.addEventListener('click', () => {
+        canvasElement.requestPointerLock();
+    });
+    document.addEventListener('mousemove', (e) => {
+        if (document.pointerLockElement === canvasElement) {
+            look[0] += e.movementX;
+            look[1] += e.movementY;
+            changed = true;
         }
-        if (e.code == "KeyD" || e.key == "ArrowRight") {
-            currentActions.delete("move_right");
+    });
+    // Ask for the frame around the mouse to be kept up to date first (see PartialUpdate::Pattern::region): around the cursor, or the middle while looking around.
+    const regionSize = 128;
+    const region = new DataView(new ArrayBuffer(8));
+    function sendRegion(x, y, size) {
+        if (socket.readyState !== WebSocket.OPEN) {
+            return;
         }
-        if (e.code == "Space") {
-            currentActions.delete("move_up");
+        region.setUint16(0, Math.max(0, Math.round(x - size / 2)), true);
+        region.setUint16(2, Math.max(0, Math.round(y - size / 2)), true);
+        region.setUint16(4, size, true);
+        region.setUint16(6, size, true);
+        socket.send(region.buffer);
+    }
+    canvasElement.addEventListener('mousemove', (e) => {
+        if (document.pointerLockElement !== canvasElement) {
+            const bounds = canvasElement.getBoundingClientRect();
+            sendRegion((e.clientX - bounds.left) * canvasElement.width / bounds.width, (e.clientY - bounds.top) * canvasElement.height / bounds.height, regionSize);
         }
-        if (e.code == "ShiftLeft") {
-            currentActions.delete("move_down");
+    });
+    canvasElement.addEventListener('mouseleave', () => {
+        if (document.pointerLockElement !== canvasElement) {
+            sendRegion(0, 0, 0);
+        }
+    });
+    document.addEventListener('pointerlockchange', () => {
+        if (document.pointerLockElement === canvasElement) {
+            sendRegion(canvasElement.width / 2, canvasElement.height / 2, regionSize);
         }
     });
-    setInterval(() => {
-        for (let action of currentActions) {
-            console.log(action);
-            socket.send(action);
+    const message = new DataView(new ArrayBuffer(16));
+    function sendInput() {
+        if (changed && socket.readyState === WebSocket.OPEN) {
+            // Right, up and forward axes, from -1 to 1.
+            const axes = [0, 0, 0];
+            for (let code of heldKeys) {
+                const [axis, sign] = keyAxes[code];
+                axes[axis] += sign;
+            }
+            message.setUint32(0, ++sequence, true);
+            for (let i = 0; i < 3; ++i) {
+                message.setInt8(4 + i, Math.sign(axes[i]));
+            }
+            message.setFloat32(8, look[0], true);
+            message.setFloat32(12, look[1], true);
+            socket.send(message.buffer);
+            look = [0, 0];
+            changed = false;
         }
-    }, 16);
+        requestAnimationFrame(sendInput);
+    }
+    requestAnimationFrame(sendInput);
 }
\ No newline at end of file